@@ -1,4 +1,5 @@
 #include "db.h"
+#include "persist.h"
 #include <errno.h>
 #include <string.h>
 #include <stdlib.h>
@@ -9,7 +10,22 @@ node_t *search(char *, node_t *, node_t **);
 
 node_t head = { "", "", 0, 0 };
 
-#ifdef COARSE_LOCK
+/* Number of nodes in existence, kept up to date by node_create() and
+ * node_destroy() so bulk_flush() can size up the tree without a walk. */
+long node_count;
+
+/* Bulk loading ("f" command).  Runs of adds are collected, sorted and
+ * merged into the tree in one pass.  A merge rebuilds the whole tree,
+ * so it only pays when the batch is at least BULK_MERGE_MIN names and
+ * at least 1/BULK_MERGE_RATIO of the tree; smaller batches are
+ * inserted one at a time. */
+#define BULK_MERGE_MIN 1024
+#define BULK_MERGE_RATIO 8
+#define BULK_MAX_DEPTH 8	/* limit on scripts running scripts */
+
+int bulk_load(char *, bulk_t *, int);
+
+#if defined(COARSE_LOCK) || defined(FINE_LOCK)
 pthread_rwlock_t rwlock = PTHREAD_RWLOCK_INITIALIZER;
 
 int  pthread_rwlock_rdlock(pthread_rwlock_t *rwlock);
@@ -17,6 +33,25 @@ int  pthread_rwlock_wrlock(pthread_rwlock_t *rwlock);
 int  pthread_rwlock_unlock(pthread_rwlock_t *rwlock);
 #endif
 
+#ifdef FINE_LOCK
+/* Node locks alone let an add and a delete of the same name reach the
+ * log in the opposite order to the tree, so while logging, changes to
+ * one name are serialized through one of these. */
+#define NAME_STRIPES 64
+pthread_mutex_t name_locks[NAME_STRIPES] = {
+	[0 ... NAME_STRIPES - 1] = PTHREAD_MUTEX_INITIALIZER
+};
+
+pthread_mutex_t *name_lock(char *name)
+{
+	unsigned int hash = 0;
+
+	while (*name != '\0')
+		hash = hash * 31 + (unsigned char)*name++;
+	return &name_locks[hash % NAME_STRIPES];
+}
+#endif
+
 node_t *node_create(char *arg_name, char *arg_value,
 			 node_t * arg_left, node_t * arg_right)
 {
@@ -45,6 +80,7 @@ node_t *node_create(char *arg_name, char *arg_value,
     pthread_rwlock_init(&new_node->node_lock, NULL);
     //new_node->node_lock = PTHREAD_RWLOCK_INITIALIZER;
     #endif
+	__sync_fetch_and_add(&node_count, 1);
 
 	return new_node;
 }
@@ -56,6 +92,7 @@ void node_destroy(node_t * node)
 	if (node->value != 0)
 		free(node->value);
 	free(node);
+	__sync_fetch_and_sub(&node_count, 1);
 }
 
 void query(char *name, char *result, int len)
@@ -78,6 +115,188 @@ void query(char *name, char *result, int len)
 	}
 }
 
+/* Ordered scans ("r" and "p" commands).  The response is
+ * "<count> found: name value name value ...", followed by "more <name>"
+ * when the limit or the size of the response cut the scan short; the
+ * client continues from <name>, the first match not returned.
+ *
+ * The walk uses an explicit stack, since the tree need not be balanced,
+ * and lets go of the tree lock every SCAN_BATCH nodes so that a long
+ * scan does not hold up writers; it then seeks back to just after the
+ * last name it visited. */
+#define SCAN_LIMIT 1000		/* default number of pairs per response */
+#define SCAN_BATCH 256		/* nodes visited per hold of the tree lock */
+#define SCAN_HEADER 24		/* room for "<count> found:" */
+
+typedef struct Scan {
+	char *hi;		/* last name in range for "r", or 0 */
+	char *prefix;		/* required prefix for "p", or 0 */
+	int limit;
+	int count;		/* pairs written so far */
+	char *out;		/* the pairs, each preceded by a space */
+	int used;
+	int room;
+	char next[256];		/* first match not written, if more */
+	int more;
+	node_t **stack;
+	int max_depth;
+} scan_t;
+
+/* Returns 1 if NODE belongs in the scan.  Nodes are visited in order,
+ * so the first one that does not marks the end. */
+int scan_match(scan_t *scan, node_t *node)
+{
+	if (scan->hi != 0)
+		return strcmp(node->name, scan->hi) <= 0;
+	return strncmp(node->name, scan->prefix, strlen(scan->prefix)) == 0;
+}
+
+/* Writes NODE to the response.  Returns 1 if it did not fit, in which
+ * case it becomes the continuation point. */
+int scan_emit(scan_t *scan, node_t *node)
+{
+	int n;
+
+	if (scan->count < scan->limit) {
+		n = snprintf(scan->out + scan->used, scan->room - scan->used,
+			     " %s %s", node->name, node->value);
+		if (n < scan->room - scan->used) {
+			scan->used += n;
+			scan->count++;
+			return 0;
+		}
+		scan->out[scan->used] = '\0';
+	}
+
+	strcpy(scan->next, node->name);
+	scan->more = 1;
+	return 1;
+}
+
+int scan_push(scan_t *scan, int depth, node_t *node)
+{
+	node_t **grown;
+
+	if (depth == scan->max_depth) {
+		scan->max_depth = scan->max_depth ? scan->max_depth * 2 : 64;
+		grown = (node_t **) realloc(scan->stack,
+					    scan->max_depth * sizeof(node_t *));
+		if (grown == 0)
+			return -1;
+		scan->stack = grown;
+	}
+	scan->stack[depth] = node;
+	return depth + 1;
+}
+
+/* Visits up to SCAN_BATCH nodes in order, starting at the first name
+ * that is >= FROM, or > FROM if AFTER is set, and leaves the last name
+ * visited in FROM.  Must be called with the tree locked.  Returns 1 once
+ * the scan is complete, 0 if there may be more to visit and -1 if out
+ * of memory. */
+int scan_batch(scan_t *scan, char *from, int after)
+{
+	node_t *node = head.rchild;
+	int depth = 0;
+	int visited = 0;
+	int cmp;
+
+	/* stack up the path to the first name to visit */
+	while (node != 0) {
+		cmp = strcmp(node->name, from);
+		if (cmp > 0 || (cmp == 0 && !after)) {
+			if ((depth = scan_push(scan, depth, node)) == -1)
+				return -1;
+			node = node->lchild;
+		} else {
+			node = node->rchild;
+		}
+	}
+
+	while (depth > 0) {
+		node = scan->stack[--depth];
+		if (!scan_match(scan, node) || scan_emit(scan, node))
+			return 1;
+
+		if (++visited == SCAN_BATCH) {
+			strcpy(from, node->name);
+			return 0;
+		}
+
+		for (node = node->rchild; node != 0; node = node->lchild)
+			if ((depth = scan_push(scan, depth, node)) == -1)
+				return -1;
+	}
+
+	return 1;
+}
+
+/* Runs SCAN from the name FROM and writes the result to RESPONSE. */
+void scan_run(scan_t *scan, char *from, char *response, int len)
+{
+	char start[256];
+	char header[SCAN_HEADER];
+	char *p;
+	int after = 0;
+	int ret;
+	int n;
+
+	if (len <= SCAN_HEADER) {
+		strncpy(response, "response too long", len - 1);
+		return;
+	}
+
+	scan->out = response + SCAN_HEADER;
+	scan->room = len - SCAN_HEADER;
+	scan->out[0] = '\0';
+	strcpy(start, from);
+
+	do {
+		/* FINE_LOCK point operations walk the tree without taking
+		 * node locks, so as with snapshots, exclude them all */
+        #ifdef COARSE_LOCK
+        pthread_rwlock_rdlock(&rwlock);
+        #endif
+        #ifdef FINE_LOCK
+        pthread_rwlock_wrlock(&rwlock);
+        #endif
+		ret = scan_batch(scan, start, after);
+        #if defined(COARSE_LOCK) || defined(FINE_LOCK)
+        pthread_rwlock_unlock(&rwlock);
+        #endif
+		after = 1;
+	} while (ret == 0);
+
+	free(scan->stack);
+	if (ret == -1) {
+		strncpy(response, "out of memory", len - 1);
+		return;
+	}
+
+	/* give back pairs until the continuation point fits after them */
+	while (scan->more
+	       && scan->used + 6 + (int)strlen(scan->next) >= scan->room) {
+		if (scan->count == 0) {
+			strncpy(response, "response too long", len - 1);
+			return;
+		}
+		scan->out[scan->used] = '\0';
+		p = strrchr(scan->out, ' ');
+		*p = '\0';
+		p = strrchr(scan->out, ' ');
+		strcpy(scan->next, p + 1);
+		scan->used = p - scan->out;
+		scan->count--;
+	}
+	if (scan->more)
+		scan->used += sprintf(scan->out + scan->used, " more %s",
+				      scan->next);
+
+	n = snprintf(header, sizeof(header), "%d found:", scan->count);
+	memcpy(response, header, n);
+	memmove(response + n, scan->out, scan->used + 1);
+}
+
 int add(char *name, char *value)
 {
 	node_t *parent;
@@ -242,11 +461,319 @@ node_t *search(char *name, node_t * parent, node_t ** parentpp)
 	return (result);
 }
 
+/* Turns the tree hanging off head.rchild into a "vine": a list linked
+ * through rchild, in order, by rotating every left child up.  Uses no
+ * stack however unbalanced the tree is.  Returns the number of nodes. */
+int tree_to_vine(void)
+{
+	node_t *tail = &head;
+	node_t *rest = head.rchild;
+	node_t *tmp;
+	int count = 0;
+
+	while (rest != 0) {
+		if (rest->lchild == 0) {
+			tail = rest;
+			rest = rest->rchild;
+			count++;
+		} else {
+			tmp = rest->lchild;
+			rest->lchild = tmp->rchild;
+			tmp->rchild = rest;
+			rest = tmp;
+			tail->rchild = tmp;
+		}
+	}
+
+	return count;
+}
+
+/* Rotates every other node of the first COUNT on the vine hanging off
+ * head.rchild down to the left of its successor. */
+void vine_compress(int count)
+{
+	node_t *scanner = &head;
+	node_t *child;
+
+	while (count-- > 0) {
+		child = scanner->rchild;
+		scanner->rchild = child->rchild;
+		scanner = scanner->rchild;
+		child->rchild = scanner->lchild;
+		scanner->lchild = child;
+	}
+}
+
+/* Turns the vine of SIZE nodes made by tree_to_vine() back into a
+ * balanced tree in place (Day-Stout-Warren). */
+void vine_to_tree(int size)
+{
+	int full = 1;
+
+	while (full * 2 <= size + 1)
+		full *= 2;
+	vine_compress(size + 1 - full);
+	size = full - 1;
+	while (size > 1) {
+		size /= 2;
+		vine_compress(size);
+	}
+}
+
+/* Builds a balanced tree out of the sorted NODES[lo..hi). */
+node_t *tree_build(node_t **nodes, int lo, int hi)
+{
+	int mid;
+
+	if (lo >= hi)
+		return 0;
+
+	mid = lo + (hi - lo) / 2;
+	nodes[mid]->lchild = tree_build(nodes, lo, mid);
+	nodes[mid]->rchild = tree_build(nodes, mid + 1, hi);
+	return nodes[mid];
+}
+
+/* Adds ADDS[lo..hi) middle first, so a sorted batch does not turn into
+ * a chain. */
+int add_range(bulk_t *bulk, pending_t *adds, int lo, int hi)
+{
+	int mid;
+	int added = 0;
+
+	if (lo >= hi)
+		return 0;
+
+	mid = lo + (hi - lo) / 2;
+	if (add(adds[mid].name, adds[mid].value)) {
+		bulk->lsn = persist_log_add(adds[mid].name, adds[mid].value);
+		added = 1;
+	}
+	return added + add_range(bulk, adds, lo, mid)
+	    + add_range(bulk, adds, mid + 1, hi);
+}
+
+int pending_compare(const void *a_, const void *b_)
+{
+	const pending_t *a = a_;
+	const pending_t *b = b_;
+	int cmp = strcmp(a->name, b->name);
+
+	if (cmp != 0)
+		return cmp;
+	return a->seq - b->seq;
+}
+
+/* Merges the sorted, duplicate-free ADDS into the tree and rebuilds it
+ * balanced.  Names already in the tree keep their old value, as add()
+ * would.  Returns the number of nodes added. */
+int tree_merge(bulk_t *bulk, pending_t *adds, int nadds)
+{
+	node_t **nodes;
+	node_t *old;
+	node_t *new_node;
+	int nold;
+	int count = 0;
+	int added = 0;
+	int cmp;
+	int i = 0;
+
+	nold = tree_to_vine();
+	nodes = (node_t **) malloc((nold + nadds) * sizeof(node_t *));
+	if (nodes == 0) {
+		/* fall back to one at a time, after rebalancing in place */
+		vine_to_tree(nold);
+		return add_range(bulk, adds, 0, nadds);
+	}
+
+	old = head.rchild;
+	while (old != 0 || i < nadds) {
+		cmp = (old == 0) ? 1 : (i == nadds) ? -1
+		    : strcmp(old->name, adds[i].name);
+		if (cmp <= 0) {
+			nodes[count++] = old;
+			old = old->rchild;
+			if (cmp == 0)
+				i++;
+		} else {
+			new_node = node_create(adds[i].name, adds[i].value, 0, 0);
+			if (new_node != 0) {
+				nodes[count++] = new_node;
+				bulk->lsn = persist_log_add(new_node->name,
+							    new_node->value);
+				added++;
+			}
+			i++;
+		}
+	}
+
+	head.rchild = tree_build(nodes, 0, count);
+	free(nodes);
+	return added;
+}
+
+/* Applies the adds collected in BULK to the tree. */
+void bulk_flush(bulk_t *bulk)
+{
+	int i;
+	int n;
+
+	if (bulk->nadds == 0)
+		return;
+
+	qsort(bulk->adds, bulk->nadds, sizeof(pending_t), pending_compare);
+	for (i = 1, n = 1; i < bulk->nadds; i++) {
+		if (strcmp(bulk->adds[i].name, bulk->adds[n - 1].name) != 0)
+			bulk->adds[n++] = bulk->adds[i];
+	}
+
+	if (n < BULK_MERGE_MIN || (long)n * BULK_MERGE_RATIO < node_count)
+		bulk->added += add_range(bulk, bulk->adds, 0, n);
+	else
+		bulk->added += tree_merge(bulk, bulk->adds, n);
+	bulk->nadds = 0;
+}
+
+/* Queues an add of NAME and VALUE, which must stay valid until the
+ * next bulk_flush(). */
+void bulk_add(bulk_t *bulk, char *name, char *value)
+{
+	pending_t *grown;
+	int capacity;
+
+	if (bulk->nadds == bulk->capacity) {
+		capacity = bulk->capacity ? bulk->capacity * 2 : 1024;
+		grown = (pending_t *) realloc(bulk->adds,
+					 capacity * sizeof(pending_t));
+		if (grown != 0) {
+			bulk->adds = grown;
+			bulk->capacity = capacity;
+		} else {
+			bulk_flush(bulk);
+		}
+	}
+
+	if (bulk->nadds == bulk->capacity) {
+		/* out of memory: no batching */
+		if (add(name, value)) {
+			bulk->lsn = persist_log_add(name, value);
+			bulk->added++;
+		}
+		return;
+	}
+
+	bulk->adds[bulk->nadds].name = name;
+	bulk->adds[bulk->nadds].value = value;
+	bulk->adds[bulk->nadds].seq = bulk->seq++;
+	bulk->nadds++;
+}
+
+/* Removes NAME, after the adds queued before it. */
+void bulk_remove(bulk_t *bulk, char *name)
+{
+	bulk_flush(bulk);
+	if (xremove(name)) {
+		bulk->lsn = persist_log_remove(name);
+		bulk->removed++;
+	}
+}
+
+/* Returns the next whitespace-delimited token in [*p, end), truncated
+ * to 255 characters like sscanf("%255s") would, and NUL-terminates it.
+ * Returns 0 if there is none. */
+char *next_token(char **p, char *end)
+{
+	char *token;
+	char *q = *p;
+
+	while (q < end && (*q == ' ' || *q == '\t' || *q == '\r'))
+		q++;
+	if (q == end)
+		return 0;
+
+	token = q;
+	while (q < end && *q != ' ' && *q != '\t' && *q != '\r')
+		q++;
+	*p = (q < end) ? q + 1 : q;
+	*q = '\0';		/* END itself is writable: see bulk_load() */
+	if (q - token > 255)
+		token[255] = '\0';
+	return token;
+}
+
+/* Executes the script in FILE_NAME into BULK.  Queries have no effect
+ * and are skipped, adds are batched and deletes are applied in order.
+ * Must be called with the tree locked for writing.  Returns -1 if the
+ * file cannot be read. */
+int bulk_load(char *file_name, bulk_t *bulk, int depth)
+{
+	FILE *finput;
+	char *buf;
+	char *line;
+	char *eol;
+	char *end;
+	char *p;
+	char *name;
+	char *value;
+	long size;
+
+	if (depth > BULK_MAX_DEPTH || (finput = fopen(file_name, "r")) == 0)
+		return -1;
+
+	if (fseek(finput, 0, SEEK_END) == -1 || (size = ftell(finput)) < 0
+	    || fseek(finput, 0, SEEK_SET) == -1
+	    || (buf = (char *)malloc(size + 1)) == 0) {
+		fclose(finput);
+		return -1;
+	}
+	size = fread(buf, 1, size, finput);
+	fclose(finput);
+	end = buf + size;
+	*end = '\0';
+
+	for (line = buf; line < end; line = eol + 1) {
+		if ((eol = memchr(line, '\n', end - line)) == 0)
+			eol = end;
+		*eol = '\0';
+
+		p = line + 1;
+		switch (line[0]) {
+		case 'a':
+			name = next_token(&p, eol);
+			value = next_token(&p, eol);
+			if (name != 0 && value != 0)
+				bulk_add(bulk, name, value);
+			break;
+
+		case 'd':
+			if ((name = next_token(&p, eol)) != 0)
+				bulk_remove(bulk, name);
+			break;
+
+		case 'f':
+			if ((name = next_token(&p, eol)) == 0)
+				break;
+			bulk_flush(bulk);
+			bulk_load(name, bulk, depth + 1);
+			break;
+
+		default:
+			/* queries and ill-formed lines do nothing */
+			break;
+		}
+	}
+
+	/* the batch points into BUF, so it must be applied before BUF goes */
+	bulk_flush(bulk);
+	free(buf);
+	return 0;
+}
+
 void interpret_command(char *command, char *response, int len)
 {
-	char value[256];
-	char ibuf[256];
-	char name[256];
+	char value[256] = "";
+	char name[256] = "";
+	long lsn = 0;		/* of the change to make durable, if any */
 
 	if (strlen(command) <= 1) {
 		strncpy(response, "ill-formed command", len - 1);
@@ -262,11 +789,11 @@ void interpret_command(char *command, char *response, int len)
 			return;
 		}
         
-        #ifdef COARSE_LOCK
+        #if defined(COARSE_LOCK) || defined(FINE_LOCK)
         pthread_rwlock_rdlock(&rwlock); /*Semaphore*/
         #endif
 		query(name, response, len);
-        #ifdef COARSE_LOCK
+        #if defined(COARSE_LOCK) || defined(FINE_LOCK)
         pthread_rwlock_unlock(&rwlock);
         #endif
         
@@ -276,6 +803,34 @@ void interpret_command(char *command, char *response, int len)
 
 		return;
 
+	case 'r':
+	case 'p':
+		/* Range "r <lo> <hi> [limit]" or prefix "p <prefix> [limit [from]]" */
+		{
+			scan_t scan = { 0 };
+			char from[256] = "";
+			int n;
+
+			scan.limit = SCAN_LIMIT;
+			if (command[0] == 'r') {
+				n = sscanf(&command[1], "%255s %255s %d", name, value,
+					   &scan.limit);
+				scan.hi = value;
+			} else {
+				n = sscanf(&command[1], "%255s %d %255s", name,
+					   &scan.limit, from);
+				scan.prefix = name;
+			}
+			if (n < (command[0] == 'r' ? 2 : 1) || scan.limit < 1) {
+				strncpy(response, "ill-formed command", len - 1);
+				return;
+			}
+
+			scan_run(&scan, strcmp(from, name) > 0 ? from : name,
+			     response, len);
+		}
+		return;
+
 	case 'a':
 		/* Add to the database */
 		sscanf(&command[1], "%255s %255s", name, value);
@@ -286,15 +841,27 @@ void interpret_command(char *command, char *response, int len)
 
         #ifdef COARSE_LOCK
         pthread_rwlock_wrlock(&rwlock); /*Semaphore*/
+        #endif
+        #ifdef FINE_LOCK
+        pthread_rwlock_rdlock(&rwlock); /* only excludes bulk loads */
+        if (persist_enabled)
+            pthread_mutex_lock(name_lock(name));
         #endif
 		if (add(name, value)) {
+			/* log while still locked, so the log order is the tree's */
+			lsn = persist_log_add(name, value);
 			strncpy(response, "added", len - 1);
 		} else {
 			strncpy(response, "already in database", len - 1);
 		}
-        #ifdef COARSE_LOCK
+        #ifdef FINE_LOCK
+        if (persist_enabled)
+            pthread_mutex_unlock(name_lock(name));
+        #endif
+        #if defined(COARSE_LOCK) || defined(FINE_LOCK)
         pthread_rwlock_unlock(&rwlock);
         #endif
+		persist_commit(lsn);
 
 		return;
 
@@ -308,15 +875,26 @@ void interpret_command(char *command, char *response, int len)
 
         #ifdef COARSE_LOCK
         pthread_rwlock_wrlock(&rwlock); /*Semaphore*/
+        #endif
+        #ifdef FINE_LOCK
+        pthread_rwlock_rdlock(&rwlock); /* only excludes bulk loads */
+        if (persist_enabled)
+            pthread_mutex_lock(name_lock(name));
         #endif
 		if (xremove(name)) {
+			lsn = persist_log_remove(name);
 			strncpy(response, "removed", len - 1);
 		} else {
 			strncpy(response, "not in database", len - 1);
 		}
-        #ifdef COARSE_LOCK
+        #ifdef FINE_LOCK
+        if (persist_enabled)
+            pthread_mutex_unlock(name_lock(name));
+        #endif
+        #if defined(COARSE_LOCK) || defined(FINE_LOCK)
         pthread_rwlock_unlock(&rwlock);
         #endif 
+		persist_commit(lsn);
 
 		return;
 
@@ -329,17 +907,27 @@ void interpret_command(char *command, char *response, int len)
 		}
 
 		{
-			FILE *finput = fopen(name, "r");
-			if (!finput) {
+			bulk_t bulk = { 0, 0, 0, 0, 0, 0, 0 };
+			int ret;
+
+			/* the whole script runs under one write lock */
+            #if defined(COARSE_LOCK) || defined(FINE_LOCK)
+            pthread_rwlock_wrlock(&rwlock);
+            #endif
+			ret = bulk_load(name, &bulk, 0);
+            #if defined(COARSE_LOCK) || defined(FINE_LOCK)
+            pthread_rwlock_unlock(&rwlock);
+            #endif
+			free(bulk.adds);
+			persist_commit(bulk.lsn);
+
+			if (ret == -1) {
 				strncpy(response, "bad file name", len - 1);
 				return;
 			}
-			while (fgets(ibuf, sizeof(ibuf), finput) != 0) {
-				interpret_command(ibuf, response, len);
-			}
-			fclose(finput);
+			snprintf(response, len, "file processed: %d added, %d removed",
+				 bulk.added, bulk.removed);
 		}
-		strncpy(response, "file processed", len - 1);
 		return;
 
 	default:
@@ -12,8 +12,38 @@ typedef struct Node {
 
 extern node_t head;
 
-#ifdef COARSE_LOCK
+#if defined(COARSE_LOCK) || defined(FINE_LOCK)
+/* With COARSE_LOCK this protects the whole tree.  With FINE_LOCK point
+ * operations only take it for reading (the node locks do the rest), so
+ * that a bulk load can take it for writing and rebuild the tree. */
 extern pthread_rwlock_t rwlock;
 #endif
 
+/* A batch of changes applied with few passes over the tree (see
+ * bulk_load()).  Queued adds are sorted and deduplicated, the first add
+ * of a name winning, and applied before the next remove or flush. */
+typedef struct Pending {
+	char *name;
+	char *value;
+	int seq;
+} pending_t;
+
+typedef struct Bulk {
+	pending_t *adds;
+	int nadds;
+	int capacity;
+	int seq;
+	int added;
+	int removed;
+	long lsn;		/* of the last change logged */
+} bulk_t;
+
+void bulk_add(bulk_t *, char *, char *);
+void bulk_remove(bulk_t *, char *);
+void bulk_flush(bulk_t *);
+
+node_t *node_create(char *, char *, node_t *, node_t *);
+node_t *tree_build(node_t **, int, int);
+int add(char *, char *);
+int xremove(char *);
 void interpret_command(char *, char *, int);
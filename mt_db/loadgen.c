@@ -0,0 +1,281 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include "sockserver.h"
+
+/*
+   Load generator for the socket mode of the server.  Opens many
+   connections from a single thread and keeps a window of pipelined
+   commands outstanding on each, then reports the throughput.
+
+   Usage: loadgen [-s socket_path] [-c clients] [-n commands_per_client]
+                  [-p pipeline_depth] [-k key_space] [-r read_percent]
+ */
+
+#define MAX_EVENTS 256
+#define LINE_MAX_LEN 256
+
+typedef struct Loader {
+	int fd;
+	int sent;		/* commands written so far */
+	int received;		/* response lines read so far */
+	char *out;		/* commands generated but not yet written */
+	int outlen;
+	int outoff;
+	unsigned int seed;
+} loader_t;
+
+static int num_commands = 10000;
+static int pipeline_depth = 16;
+static int key_space = 100000;
+static int read_percent = 80;
+
+static double now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, 0);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static int loader_connect(const char *path)
+{
+	struct sockaddr_un addr;
+	int fd;
+
+	if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) == -1) {
+		perror("socket");
+		return -1;
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+
+	if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1) {
+		perror("connect");
+		close(fd);
+		return -1;
+	}
+
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+	return fd;
+}
+
+/* Generates commands until LOADER has a full window outstanding. */
+static void loader_fill(loader_t *loader)
+{
+	char line[LINE_MAX_LEN];
+	int len;
+	int roll;
+	int key;
+
+	loader->outlen -= loader->outoff;
+	memmove(loader->out, loader->out + loader->outoff, loader->outlen);
+	loader->outoff = 0;
+
+	while (loader->sent < num_commands
+	       && loader->sent - loader->received < pipeline_depth) {
+		roll = rand_r(&loader->seed) % 100;
+		key = rand_r(&loader->seed) % key_space;
+
+		if (roll < read_percent)
+			len = sprintf(line, "q key%d\n", key);
+		else if (roll < read_percent + (100 - read_percent) / 2)
+			len = sprintf(line, "a key%d value%d\n", key, key);
+		else
+			len = sprintf(line, "d key%d\n", key);
+
+		memcpy(loader->out + loader->outlen, line, len);
+		loader->outlen += len;
+		loader->sent++;
+	}
+}
+
+/* Returns -1 if the connection failed. */
+static int loader_write(loader_t *loader)
+{
+	int ret;
+
+	while (loader->outoff < loader->outlen) {
+		ret = write(loader->fd, loader->out + loader->outoff,
+			    loader->outlen - loader->outoff);
+		if (ret == -1) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				return 0;
+			perror("write");
+			return -1;
+		}
+		loader->outoff += ret;
+	}
+	return 0;
+}
+
+/* Counts the response lines available on LOADER.  Returns -1 if the
+ * connection failed. */
+static int loader_read(loader_t *loader)
+{
+	char buf[4096];
+	char *p;
+	int ret;
+
+	while (1) {
+		ret = read(loader->fd, buf, sizeof(buf));
+		if (ret == -1) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				return 0;
+			perror("read");
+			return -1;
+		}
+		if (ret == 0) {
+			fprintf(stderr, "server closed connection\n");
+			return -1;
+		}
+		for (p = buf; (p = memchr(p, '\n', buf + ret - p)) != 0; p++)
+			loader->received++;
+	}
+}
+
+static void usage(void)
+{
+	fprintf(stderr, "Usage: loadgen [-s socket_path] [-c clients] "
+		"[-n commands_per_client] [-p pipeline_depth] [-k key_space] "
+		"[-r read_percent]\n");
+	exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+	const char *path = SOCKSERVER_DEFAULT_PATH;
+	int num_clients = 100;
+	loader_t *loaders;
+	struct epoll_event ev;
+	struct epoll_event events[MAX_EVENTS];
+	struct rlimit rl;
+	int epfd;
+	int done = 0;
+	long total;
+	double start;
+	double elapsed;
+	int opt;
+	int i;
+	int n;
+
+	while ((opt = getopt(argc, argv, "s:c:n:p:k:r:")) != -1) {
+		switch (opt) {
+		case 's':
+			path = optarg;
+			break;
+		case 'c':
+			num_clients = atoi(optarg);
+			break;
+		case 'n':
+			num_commands = atoi(optarg);
+			break;
+		case 'p':
+			pipeline_depth = atoi(optarg);
+			break;
+		case 'k':
+			key_space = atoi(optarg);
+			break;
+		case 'r':
+			read_percent = atoi(optarg);
+			break;
+		default:
+			usage();
+		}
+	}
+	if (optind != argc || num_clients < 1 || num_commands < 1
+	    || pipeline_depth < 1 || key_space < 1
+	    || read_percent < 0 || read_percent > 100)
+		usage();
+
+	if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+		rl.rlim_cur = rl.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &rl);
+	}
+
+	if ((epfd = epoll_create1(0)) == -1) {
+		perror("epoll_create1");
+		exit(1);
+	}
+
+	loaders = (loader_t *) calloc(num_clients, sizeof(loader_t));
+	if (loaders == 0) {
+		fprintf(stderr, "out of memory\n");
+		exit(1);
+	}
+
+	for (i = 0; i < num_clients; i++) {
+		loaders[i].fd = loader_connect(path);
+		loaders[i].seed = i + 1;
+		loaders[i].out = (char *)malloc(pipeline_depth * LINE_MAX_LEN);
+		if (loaders[i].fd == -1 || loaders[i].out == 0)
+			exit(1);
+
+		ev.events = EPOLLIN | EPOLLOUT | EPOLLET;
+		ev.data.ptr = &loaders[i];
+		if (epoll_ctl(epfd, EPOLL_CTL_ADD, loaders[i].fd, &ev) == -1) {
+			perror("epoll_ctl");
+			exit(1);
+		}
+	}
+
+	printf("%d clients connected, %d commands each, pipeline depth %d\n",
+	       num_clients, num_commands, pipeline_depth);
+
+	start = now();
+	for (i = 0; i < num_clients; i++) {
+		loader_fill(&loaders[i]);
+		if (loader_write(&loaders[i]) == -1)
+			exit(1);
+	}
+
+	while (done < num_clients) {
+		n = epoll_wait(epfd, events, MAX_EVENTS, -1);
+		if (n == -1) {
+			if (errno == EINTR)
+				continue;
+			perror("epoll_wait");
+			exit(1);
+		}
+
+		for (i = 0; i < n; i++) {
+			loader_t *loader = (loader_t *) events[i].data.ptr;
+
+			if (events[i].events & EPOLLIN) {
+				if (loader_read(loader) == -1)
+					exit(1);
+				if (loader->received >= num_commands) {
+					epoll_ctl(epfd, EPOLL_CTL_DEL, loader->fd, NULL);
+					close(loader->fd);
+					done++;
+					continue;
+				}
+				loader_fill(loader);
+			}
+			if (loader_write(loader) == -1)
+				exit(1);
+		}
+	}
+	elapsed = now() - start;
+
+	total = (long)num_clients * num_commands;
+	printf("%ld commands in %.3f s: %.0f commands/s\n",
+	       total, elapsed, total / elapsed);
+
+	return 0;
+}
@@ -0,0 +1,675 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include "db.h"
+#include "persist.h"
+
+/*
+   On-disk layout, inside the data directory:
+
+     snapshot      every pair in the tree, in order, plus the number of
+                   the first log generation that is not included in it
+     wal.<n>       log generation n; a new one is started whenever a
+                   snapshot is taken, and older ones are then deleted
+
+   A log record is the operation ('a' or 'd'), the name and value
+   lengths (one byte each, since names and values are at most 255
+   characters), the bytes of the name and value, and a checksum that
+   lets recovery ignore a record torn by a crash.  A snapshot is a
+   snap_header_t followed by length-prefixed names and values.
+ */
+
+#define SNAP_MAGIC 0x50414e53424454ULL	/* "TDBSNAP" */
+#define WAL_SPILL (8 << 20)	/* write out (without syncing) past this */
+#define PATH_LEN 4096
+#define DIR_LEN (PATH_LEN - 32)	/* leaves room for the file names */
+
+typedef struct SnapHeader {
+	uint64_t magic;
+	uint64_t wal_seq;
+	uint64_t count;
+} snap_header_t;
+
+int persist_enabled = 0;
+
+static char data_dir[DIR_LEN];
+static int snapshot_interval;
+
+/* The log.  LSNs count records; appended_lsn is the last one handed
+ * out and durable_lsn the last one known to be on disk.  Records after
+ * the last write sit in buf.  One committing thread at a time (the one
+ * that set flushing) writes and syncs on behalf of everybody. */
+static pthread_mutex_t wal_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wal_flushed = PTHREAD_COND_INITIALIZER;
+static int wal_fd = -1;
+static unsigned long wal_seq;
+static char *wal_buf;
+static size_t wal_len;
+static size_t wal_cap;
+static char *wal_spare;
+static size_t wal_spare_cap;
+static long appended_lsn;
+static long durable_lsn;
+static long snapshot_lsn;	/* appended_lsn as of the last rotation */
+static int flushing;
+
+/* Only one snapshot at a time. */
+static pthread_mutex_t checkpoint_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t checkpoint_thread;
+
+static void *checkpoint_run(void *);
+
+static void wal_path(char *path, unsigned long seq)
+{
+	snprintf(path, PATH_LEN, "%s/wal.%08lu", data_dir, seq);
+}
+
+static void snapshot_path(char *path, const char *suffix)
+{
+	snprintf(path, PATH_LEN, "%s/snapshot%s", data_dir, suffix);
+}
+
+/* FNV-1a, enough to tell a torn record from a complete one. */
+static uint32_t checksum(const unsigned char *data, size_t len)
+{
+	uint32_t hash = 2166136261u;
+
+	while (len-- > 0) {
+		hash ^= *data++;
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+/* Writes all of DATA to FD, exiting on failure: once the log cannot be
+ * written, acknowledged changes could be lost. */
+static void write_all(int fd, const char *data, size_t len, const char *what)
+{
+	ssize_t ret;
+
+	while (len > 0) {
+		ret = write(fd, data, len);
+		if (ret == -1) {
+			if (errno == EINTR)
+				continue;
+			perror(what);
+			exit(1);
+		}
+		data += ret;
+		len -= ret;
+	}
+}
+
+static void sync_dir(void)
+{
+	int fd = open(data_dir, O_RDONLY);
+
+	if (fd != -1) {
+		fsync(fd);
+		close(fd);
+	}
+}
+
+static int wal_create(unsigned long seq)
+{
+	char path[PATH_LEN];
+	int fd;
+
+	wal_path(path, seq);
+	if ((fd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0600)) == -1) {
+		perror(path);
+		return -1;
+	}
+	sync_dir();
+	return fd;
+}
+
+/* Appends a record to the log buffer.  Returns its LSN. */
+static long wal_append(char op, const char *name, const char *value)
+{
+	unsigned char rec[3 + 255 + 255 + 4];
+	size_t nlen = strlen(name);
+	size_t vlen = strlen(value);
+	size_t len;
+	uint32_t sum;
+	char *grown;
+	long lsn;
+
+	if (nlen > 255)
+		nlen = 255;
+	if (vlen > 255)
+		vlen = 255;
+
+	rec[0] = op;
+	rec[1] = nlen;
+	rec[2] = vlen;
+	memcpy(rec + 3, name, nlen);
+	memcpy(rec + 3 + nlen, value, vlen);
+	len = 3 + nlen + vlen;
+	sum = checksum(rec, len);
+	memcpy(rec + len, &sum, sizeof(sum));
+	len += sizeof(sum);
+
+	pthread_mutex_lock(&wal_mutex);
+	if (wal_len + len > wal_cap) {
+		size_t cap = wal_cap ? wal_cap * 2 : 65536;
+		if ((grown = (char *)realloc(wal_buf, cap)) == 0) {
+			fprintf(stderr, "out of memory for the log\n");
+			exit(1);
+		}
+		wal_buf = grown;
+		wal_cap = cap;
+	}
+	memcpy(wal_buf + wal_len, rec, len);
+	wal_len += len;
+	lsn = ++appended_lsn;
+
+	/* Bulk loads can append millions of records before committing;
+	 * push them to the kernel early.  Not while a commit is writing,
+	 * or the records would reach the file out of order. */
+	if (wal_len > WAL_SPILL && !flushing) {
+		write_all(wal_fd, wal_buf, wal_len, "log write");
+		wal_len = 0;
+	}
+	pthread_mutex_unlock(&wal_mutex);
+
+	return lsn;
+}
+
+/* Takes the buffered records for writing.  Called with wal_mutex held
+ * by the thread that just set flushing. */
+static char *wal_take(size_t *len)
+{
+	char *data = wal_buf;
+	size_t cap = wal_cap;
+
+	*len = wal_len;
+	wal_buf = wal_spare;
+	wal_cap = wal_spare_cap;
+	wal_len = 0;
+	wal_spare = data;
+	wal_spare_cap = cap;
+	return data;
+}
+
+long persist_log_add(const char *name, const char *value)
+{
+	if (!persist_enabled)
+		return 0;
+	return wal_append('a', name, value);
+}
+
+long persist_log_remove(const char *name)
+{
+	if (!persist_enabled)
+		return 0;
+	return wal_append('d', name, "");
+}
+
+/* Waits until the record with LSN (and so every earlier one) is on
+ * disk.  The first thread to get here writes and syncs everything
+ * appended so far; threads arriving meanwhile wait for it and are then
+ * usually covered by that sync or by the next one. */
+void persist_commit(long lsn)
+{
+	char *data;
+	size_t len;
+	long target;
+	int fd;
+
+	if (!persist_enabled || lsn == 0)
+		return;
+
+	pthread_mutex_lock(&wal_mutex);
+	while (durable_lsn < lsn) {
+		if (flushing) {
+			pthread_cond_wait(&wal_flushed, &wal_mutex);
+			continue;
+		}
+
+		flushing = 1;
+		target = appended_lsn;
+		fd = wal_fd;
+		data = wal_take(&len);
+		pthread_mutex_unlock(&wal_mutex);
+
+		write_all(fd, data, len, "log write");
+		if (fdatasync(fd) == -1) {
+			perror("log sync");
+			exit(1);
+		}
+
+		pthread_mutex_lock(&wal_mutex);
+		durable_lsn = target;
+		flushing = 0;
+		pthread_cond_broadcast(&wal_flushed);
+	}
+	pthread_mutex_unlock(&wal_mutex);
+}
+
+/* Finishes the current log generation and starts the next one.  The
+ * caller must keep the tree from changing, so that the new generation
+ * holds exactly the changes made after this point. */
+static int wal_rotate(void)
+{
+	char *data;
+	size_t len;
+	long target;
+	int old_fd;
+	int new_fd;
+
+	if ((new_fd = wal_create(wal_seq + 1)) == -1)
+		return -1;
+
+	pthread_mutex_lock(&wal_mutex);
+	while (flushing)
+		pthread_cond_wait(&wal_flushed, &wal_mutex);
+	flushing = 1;
+	target = appended_lsn;
+	snapshot_lsn = target;
+	old_fd = wal_fd;
+	data = wal_take(&len);
+	wal_fd = new_fd;
+	wal_seq++;
+	pthread_mutex_unlock(&wal_mutex);
+
+	write_all(old_fd, data, len, "log write");
+	fdatasync(old_fd);
+	close(old_fd);
+
+	pthread_mutex_lock(&wal_mutex);
+	durable_lsn = target;
+	flushing = 0;
+	pthread_cond_broadcast(&wal_flushed);
+	pthread_mutex_unlock(&wal_mutex);
+
+	return 0;
+}
+
+/* Appends one name/value pair of a snapshot to BUF. */
+static int snap_append(char **buf, size_t *len, size_t *cap, node_t *node)
+{
+	size_t nlen = strlen(node->name);
+	size_t vlen = strlen(node->value);
+	char *grown;
+
+	if (nlen > 255)
+		nlen = 255;
+	if (vlen > 255)
+		vlen = 255;
+
+	if (*len + 2 + nlen + vlen > *cap) {
+		size_t cap2 = *cap * 2;
+		if ((grown = (char *)realloc(*buf, cap2)) == 0)
+			return -1;
+		*buf = grown;
+		*cap = cap2;
+	}
+
+	(*buf)[(*len)++] = nlen;
+	(*buf)[(*len)++] = vlen;
+	memcpy(*buf + *len, node->name, nlen);
+	*len += nlen;
+	memcpy(*buf + *len, node->value, vlen);
+	*len += vlen;
+	return 0;
+}
+
+/* Serializes the tree in order into a freshly allocated buffer, which
+ * starts with room for the header.  Uses an explicit stack, since the
+ * tree need not be balanced. */
+static char *snap_serialize(size_t *len, uint64_t *count)
+{
+	node_t **stack = 0;
+	node_t **grown;
+	int depth = 0;
+	int max_depth = 0;
+	size_t cap = 1 << 20;
+	char *buf = (char *)malloc(cap);
+	node_t *node = head.rchild;
+
+	*len = sizeof(snap_header_t);
+	*count = 0;
+	if (buf == 0)
+		return 0;
+
+	while (node != 0 || depth > 0) {
+		if (node != 0) {
+			if (depth == max_depth) {
+				max_depth = max_depth ? max_depth * 2 : 64;
+				grown = (node_t **) realloc(stack,
+							    max_depth * sizeof(node_t *));
+				if (grown == 0)
+					goto fail;
+				stack = grown;
+			}
+			stack[depth++] = node;
+			node = node->lchild;
+		} else {
+			node = stack[--depth];
+			if (snap_append(&buf, len, &cap, node) == -1)
+				goto fail;
+			(*count)++;
+			node = node->rchild;
+		}
+	}
+
+	free(stack);
+	return buf;
+
+ fail:
+	free(stack);
+	free(buf);
+	return 0;
+}
+
+/* Takes a snapshot of the tree and deletes the log generations it
+ * makes obsolete.  Returns 0 on success, -1 on failure. */
+int persist_checkpoint(void)
+{
+	char path[PATH_LEN];
+	char tmp_path[PATH_LEN];
+	snap_header_t header;
+	unsigned long seq;
+	uint64_t count;
+	size_t len;
+	char *buf;
+	int fd;
+
+	if (!persist_enabled)
+		return -1;
+
+	pthread_mutex_lock(&checkpoint_mutex);
+
+	/* Keep the tree from changing while it is copied.  FINE_LOCK point
+	 * operations only hold the tree lock for reading, so exclude them
+	 * all; with COARSE_LOCK excluding the writers is enough. */
+    #ifdef FINE_LOCK
+    pthread_rwlock_wrlock(&rwlock);
+    #endif
+    #ifdef COARSE_LOCK
+    pthread_rwlock_rdlock(&rwlock);
+    #endif
+	if (wal_rotate() == -1) {
+		buf = 0;
+	} else {
+		seq = wal_seq;
+		buf = snap_serialize(&len, &count);
+	}
+    #if defined(COARSE_LOCK) || defined(FINE_LOCK)
+    pthread_rwlock_unlock(&rwlock);
+    #endif
+
+	if (buf == 0) {
+		pthread_mutex_unlock(&checkpoint_mutex);
+		fprintf(stderr, "snapshot failed\n");
+		return -1;
+	}
+
+	header.magic = SNAP_MAGIC;
+	header.wal_seq = seq;
+	header.count = count;
+	memcpy(buf, &header, sizeof(header));
+
+	/* write it beside the old one and atomically replace it */
+	snapshot_path(tmp_path, ".tmp");
+	snapshot_path(path, "");
+	if ((fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0600)) == -1) {
+		perror(tmp_path);
+		free(buf);
+		pthread_mutex_unlock(&checkpoint_mutex);
+		return -1;
+	}
+	write_all(fd, buf, len, "snapshot write");
+	free(buf);
+	if (fsync(fd) == -1 || close(fd) == -1 || rename(tmp_path, path) == -1) {
+		perror("snapshot");
+		pthread_mutex_unlock(&checkpoint_mutex);
+		return -1;
+	}
+	sync_dir();
+
+	/* everything before generation SEQ is now in the snapshot */
+	while (seq-- > 0) {
+		wal_path(path, seq);
+		if (unlink(path) == -1)
+			break;
+	}
+
+	pthread_mutex_unlock(&checkpoint_mutex);
+	return 0;
+}
+
+/* Loads the snapshot, if there is one, into the (empty) tree.  Returns
+ * the first log generation to replay, or 0 if the snapshot is bad. */
+static unsigned long snapshot_load(void)
+{
+	char path[PATH_LEN];
+	char name[256];
+	char value[256];
+	snap_header_t header;
+	struct stat st;
+	node_t **nodes;
+	unsigned char *map;
+	unsigned char *p;
+	unsigned char *end;
+	uint64_t i;
+	int fd;
+
+	snapshot_path(path, "");
+	if ((fd = open(path, O_RDONLY)) == -1)
+		return 1;	/* a new database */
+
+	if (fstat(fd, &st) == -1 || st.st_size < (off_t) sizeof(header)) {
+		close(fd);
+		fprintf(stderr, "%s: truncated snapshot\n", path);
+		return 0;
+	}
+
+	map = (unsigned char *)mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		perror(path);
+		return 0;
+	}
+	madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+	memcpy(&header, map, sizeof(header));
+	if (header.magic != SNAP_MAGIC
+	    || (nodes = (node_t **) malloc((header.count + 1) * sizeof(node_t *))) == 0) {
+		munmap(map, st.st_size);
+		fprintf(stderr, "%s: bad snapshot\n", path);
+		return 0;
+	}
+
+	/* the pairs are already in order, so the tree can be built
+	 * balanced without a single comparison */
+	p = map + sizeof(header);
+	end = map + st.st_size;
+	for (i = 0; i < header.count; i++) {
+		if (p + 2 > end || p + 2 + p[0] + p[1] > end)
+			break;
+		memcpy(name, p + 2, p[0]);
+		name[p[0]] = '\0';
+		memcpy(value, p + 2 + p[0], p[1]);
+		value[p[1]] = '\0';
+		p += 2 + p[0] + p[1];
+		if ((nodes[i] = node_create(name, value, 0, 0)) == 0)
+			break;
+	}
+	munmap(map, st.st_size);
+
+	if (i != header.count) {
+		free(nodes);
+		fprintf(stderr, "%s: bad snapshot\n", path);
+		return 0;
+	}
+
+	head.rchild = tree_build(nodes, 0, header.count);
+	free(nodes);
+	printf("Loaded %lu pairs from snapshot.\n", (unsigned long)header.count);
+	return header.wal_seq;
+}
+
+/* Applies the complete records of log generation SEQ to the tree,
+ * batching runs of adds like a bulk load does.  Returns the number
+ * applied, or -1 if the generation does not exist. */
+static long wal_replay(unsigned long seq)
+{
+	char path[PATH_LEN];
+	bulk_t bulk = { 0, 0, 0, 0, 0, 0, 0 };
+	struct stat st;
+	char *strings;
+	char *name;
+	char *value;
+	unsigned char *map;
+	unsigned char *p;
+	unsigned char *end;
+	uint32_t sum;
+	size_t len;
+	long count = 0;
+	int fd;
+
+	wal_path(path, seq);
+	if ((fd = open(path, O_RDONLY)) == -1)
+		return -1;
+	if (fstat(fd, &st) == -1 || st.st_size == 0) {
+		close(fd);
+		return 0;
+	}
+	map = (unsigned char *)mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		perror(path);
+		return 0;
+	}
+	madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+	/* NUL-terminated copies of the names and values, which the batch
+	 * points at; each record is longer than its two strings */
+	if ((strings = (char *)malloc(st.st_size)) == 0) {
+		munmap(map, st.st_size);
+		fprintf(stderr, "%s: out of memory\n", path);
+		return 0;
+	}
+	name = strings;
+
+	p = map;
+	end = map + st.st_size;
+	while (p + 3 <= end) {
+		len = 3 + p[1] + p[2];
+		if (p + len + sizeof(sum) > end)
+			break;
+		memcpy(&sum, p + len, sizeof(sum));
+		if (sum != checksum(p, len) || (p[0] != 'a' && p[0] != 'd'))
+			break;	/* torn by a crash; nothing after it was acknowledged */
+
+		memcpy(name, p + 3, p[1]);
+		name[p[1]] = '\0';
+		value = name + p[1] + 1;
+		memcpy(value, p + 3 + p[1], p[2]);
+		value[p[2]] = '\0';
+		if (p[0] == 'a')
+			bulk_add(&bulk, name, value);
+		else
+			bulk_remove(&bulk, name);
+		name = value + p[2] + 1;
+
+		p += len + sizeof(sum);
+		count++;
+	}
+	bulk_flush(&bulk);
+	free(bulk.adds);
+	free(strings);
+
+	if (p != end)
+		fprintf(stderr, "%s: ignoring %ld bytes of incomplete log\n",
+			path, (long)(end - p));
+	munmap(map, st.st_size);
+	return count;
+}
+
+/* Recovers the database kept in directory DIR: loads the snapshot and
+ * replays the log written since, then starts a new log generation and
+ * a thread taking a snapshot every INTERVAL seconds (if anything
+ * changed).  Must be called before any client is served.  Returns 0
+ * on success, -1 (with a message on stderr) on failure. */
+int persist_open(const char *dir, int interval)
+{
+	unsigned long seq;
+	long replayed = 0;
+	long ret;
+
+	if (strlen(dir) >= DIR_LEN) {
+		fprintf(stderr, "data directory name too long\n");
+		return -1;
+	}
+	strcpy(data_dir, dir);
+	snapshot_interval = interval;
+
+	if (mkdir(data_dir, 0700) == -1 && errno != EEXIST) {
+		perror(data_dir);
+		return -1;
+	}
+
+	if ((seq = snapshot_load()) == 0)
+		return -1;
+
+	/* generations older than the snapshot left behind by a crash */
+	wal_seq = seq;
+	while (wal_seq-- > 0) {
+		char path[PATH_LEN];
+		wal_path(path, wal_seq);
+		if (unlink(path) == -1)
+			break;
+	}
+
+	/* only the log tail written after the snapshot is replayed */
+	for (wal_seq = seq; (ret = wal_replay(wal_seq)) != -1; wal_seq++)
+		replayed += ret;
+	if (replayed > 0)
+		printf("Replayed %ld logged changes.\n", replayed);
+
+	/* never append to a generation that may end in a torn record */
+	if ((wal_fd = wal_create(wal_seq)) == -1)
+		return -1;
+
+	persist_enabled = 1;
+
+	if (snapshot_interval > 0
+	    && pthread_create(&checkpoint_thread, NULL, checkpoint_run, NULL)) {
+		fprintf(stderr, "Error creating snapshot thread\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+/* Code executed by the snapshot thread. */
+static void *checkpoint_run(void *arg)
+{
+	int changed;
+
+	(void)arg;
+
+	while (1) {
+		sleep(snapshot_interval);
+
+		pthread_mutex_lock(&wal_mutex);
+		changed = appended_lsn != snapshot_lsn;
+		pthread_mutex_unlock(&wal_mutex);
+
+		if (changed)
+			persist_checkpoint();
+	}
+
+	return 0;
+}
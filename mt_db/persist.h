@@ -0,0 +1,18 @@
+/* Persistence for the database: a write-ahead log of adds and deletes
+ * plus periodic binary snapshots of the tree, kept in one directory.
+ *
+ * Every successful add or delete is appended to the log while the tree
+ * is still locked (so the log order matches the tree), and the client
+ * waits for it to be durable with persist_commit() after unlocking.
+ * Concurrent commits share a single fdatasync (group commit).  When
+ * persistence is disabled these are all no-ops. */
+
+#define PERSIST_DEFAULT_INTERVAL 60	/* seconds between snapshots */
+
+extern int persist_enabled;
+
+int persist_open(const char *, int);
+long persist_log_add(const char *, const char *);
+long persist_log_remove(const char *);
+void persist_commit(long);
+int persist_checkpoint(void);
@@ -9,6 +9,8 @@
 #include <errno.h>
 #include "window.h"
 #include "db.h"
+#include "sockserver.h"
+#include "persist.h"
 #include <pthread.h>
 #include <sys/time.h>
 #include <time.h>
@@ -25,12 +27,26 @@ typedef struct Client {
 /* The number of client threads. */
 int num_client_threads = 0;
 
-/* Condition variable used for the STOP and GO functionality */
+/* STOP and GO functionality.  Client threads wait on go_cond while
+ * stopped is set, and the console waits on idle_cond for in_flight (the
+ * number of commands being executed) to reach zero.  All three fields
+ * are protected by stop_mutex. */
 int stopped = 0; // The program is initially not in the stopped mode (it's in GO mode)
+int in_flight = 0;
+pthread_mutex_t stop_mutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t go_cond = PTHREAD_COND_INITIALIZER;
+pthread_cond_t idle_cond = PTHREAD_COND_INITIALIZER;
+
+/* Whether every command is echoed to stdout.  Off by default in socket
+ * mode, where thousands of clients would drown the console. */
+int verbose = 1;
 
 void *client_run(void *);
 int handle_command(char *, char *, int len);
 void *my_create_client_method(void *arg);
+void server_stop(void);
+void server_go(void);
+void server_drain(void);
 
 client_t *client_create(int ID)
 {
@@ -76,23 +92,62 @@ void *client_run(void *arg)
 
 int handle_command(char *command, char *response, int len)
 {
-    printf("command received = %s\n",command);
+    if (verbose)
+        printf("command received = %s\n",command);
+    pthread_mutex_lock(&stop_mutex);
     while (stopped == 1) {
-        // The mutex for waiting
+        pthread_cond_wait(&go_cond, &stop_mutex);
     }
     
     if (command[0] == EOF) {
+        pthread_mutex_unlock(&stop_mutex);
         strncpy(response, "all done", len - 1);
         return 0;
     }
+    in_flight++;
+    pthread_mutex_unlock(&stop_mutex);
 
 	interpret_command(command, response, len);
 
-    printf("command executed = %s\n",command);
+    pthread_mutex_lock(&stop_mutex);
+    if (--in_flight == 0)
+        pthread_cond_broadcast(&idle_cond);
+    pthread_mutex_unlock(&stop_mutex);
+
+    if (verbose)
+        printf("command executed = %s\n",command);
     
 	return 1;
 }
 
+/* Makes client threads block before starting their next command. */
+void server_stop(void)
+{
+    pthread_mutex_lock(&stop_mutex);
+    stopped = 1;
+    pthread_mutex_unlock(&stop_mutex);
+}
+
+/* Wakes up every client thread blocked by server_stop(). */
+void server_go(void)
+{
+    pthread_mutex_lock(&stop_mutex);
+    stopped = 0;
+    pthread_cond_broadcast(&go_cond);
+    pthread_mutex_unlock(&stop_mutex);
+}
+
+/* Waits until no command is being executed.  After server_stop() this
+ * means the database is quiescent until the next server_go(). */
+void server_drain(void)
+{
+    pthread_mutex_lock(&stop_mutex);
+    while (in_flight > 0) {
+        pthread_cond_wait(&idle_cond, &stop_mutex);
+    }
+    pthread_mutex_unlock(&stop_mutex);
+}
+
 void *my_create_client_method(void *arg)
 {
     client_t *client = (client_t *) arg;
@@ -105,6 +160,13 @@ void *my_create_client_method(void *arg)
     return 0;    
 }
 
+static void usage(void)
+{
+    fprintf(stderr, "Usage: server [-s socket_path] [-w workers] [-v] "
+            "[-d data_dir] [-i snapshot_interval]\n");
+    exit(1);
+}
+
 int main(int argc, char *argv[])
 {
     client_t* client_threads[100]; // Array of pointers to client threads
@@ -113,9 +175,60 @@ int main(int argc, char *argv[])
     char command[20]; // shouldn't be more than 1 character
     
     int flag = 1; // true
+
+    /* Socket mode: serve clients over a Unix domain socket instead of
+     * (or in addition to) xterm windows. */
+    const char *socket_path = 0;
+    int num_workers = SOCKSERVER_DEFAULT_WORKERS;
+    int echo_commands = 0;
+    int opt;
+
+    /* Persistence: keep a log and snapshots in data_dir. */
+    const char *data_dir = 0;
+    int snapshot_interval = PERSIST_DEFAULT_INTERVAL;
+
+    while ((opt = getopt(argc, argv, "s:w:vd:i:")) != -1) {
+        switch (opt) {
+        case 's':
+            socket_path = optarg;
+            break;
+        case 'w':
+            num_workers = atoi(optarg);
+            break;
+        case 'v':
+            echo_commands = 1;
+            break;
+        case 'd':
+            data_dir = optarg;
+            break;
+        case 'i':
+            snapshot_interval = atoi(optarg);
+            break;
+        default:
+            usage();
+        }
+    }
+    if (optind != argc)
+        usage();
+
+    /* recover before anyone can see the database */
+    if (data_dir != 0 && persist_open(data_dir, snapshot_interval) == -1)
+        exit(1);
+
+    if (socket_path != 0) {
+        verbose = echo_commands;
+        signal(SIGPIPE, SIG_IGN); // a client hanging up must not kill the server
+        if (sockserver_start(socket_path, num_workers) == -1)
+            exit(1);
+    }
     
     while (flag == 1){
-        fgets (command, 20, stdin); // This isn't a "bulletproof" way of receiving input. Maybe we improve it later.
+        if (fgets (command, 20, stdin) == 0) { // This isn't a "bulletproof" way of receiving input. Maybe we improve it later.
+            /* No console (e.g. started headless): keep serving the socket. */
+            if (socket_path != 0)
+                sockserver_join();
+            break;
+        }
         
         if (command[0] == 'e') {
             client_t client_thread;
@@ -131,16 +244,19 @@ int main(int argc, char *argv[])
                return 1;
             }
         } else if (command[0] == 's') {
-            stopped = 1; // STOP
+            server_stop(); // STOP
             printf("Stop mode.\n");
         } else if (command[0] == 'g') {
-            stopped = 0; // GO
+            server_go(); // GO
             printf("Go mode.\n");
-        }
-
-        if (argc != 1) {
-            fprintf(stderr, "Usage: server\n");
-            exit(1);
+        } else if (command[0] == 'w') {
+            server_drain(); // WAIT for in-flight commands
+            printf("Drained.\n");
+        } else if (command[0] == 'c') {
+            if (persist_checkpoint() == 0) // CHECKPOINT
+                printf("Snapshot taken.\n");
+            else
+                printf("No snapshot taken.\n");
         }
     }
     /*
@@ -0,0 +1,392 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include "sockserver.h"
+
+#define MAX_WORKERS 64
+#define MAX_EVENTS 64
+#define CONN_INBUF 4096		/* longest command line we buffer */
+#define CONN_RESPONSE 256	/* same size client_run() uses */
+#define CONN_SCAN_RESPONSE (64 << 10)	/* for "r" and "p", which return many pairs */
+#define CONN_OUT_HIGH (1 << 20)	/* stop reading while this much is unsent */
+#define READS_PER_WAKEUP 16	/* so one chatty client can't hog a worker */
+
+/* One connected client.  Connections are registered with EPOLLONESHOT,
+ * so at most one worker owns a connection at any time and none of
+ * these fields need a lock. */
+typedef struct Conn {
+	int fd;
+	char in[CONN_INBUF];
+	int inlen;
+	char *out;
+	int outlen;
+	int outoff;
+	int outcap;
+} conn_t;
+
+static int listen_fd = -1;
+static int epoll_fd = -1;
+static int num_workers = 0;
+static pthread_t workers[MAX_WORKERS];
+
+/* epoll data for the listening socket; connections use their conn_t */
+static char listener_tag;
+
+static void *worker_run(void *);
+static void accept_clients(void);
+static void conn_service(conn_t *, unsigned int);
+static int conn_read(conn_t *);
+static int conn_flush(conn_t *);
+static void conn_execute(conn_t *);
+static int conn_append(conn_t *, const char *, int);
+static void conn_rearm(conn_t *);
+static void conn_destroy(conn_t *);
+
+static int set_nonblocking(int fd)
+{
+	int flags = fcntl(fd, F_GETFL, 0);
+
+	if (flags == -1)
+		return -1;
+	return fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+/* Allow as many descriptors as the hard limit permits, since every
+ * client holds one open for as long as it is connected. */
+static void raise_fd_limit(void)
+{
+	struct rlimit rl;
+
+	if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+		rl.rlim_cur = rl.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &rl);
+	}
+}
+
+/* Binds the socket at PATH and starts NWORKERS threads serving it.
+ * Returns 0 on success, -1 (with a message on stderr) on failure. */
+int sockserver_start(const char *path, int nworkers)
+{
+	struct sockaddr_un addr;
+	struct epoll_event ev;
+	int i;
+
+	if (nworkers < 1)
+		nworkers = 1;
+	if (nworkers > MAX_WORKERS)
+		nworkers = MAX_WORKERS;
+
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		fprintf(stderr, "socket path too long: %s\n", path);
+		return -1;
+	}
+
+	raise_fd_limit();
+
+	if ((listen_fd = socket(AF_UNIX, SOCK_STREAM, 0)) == -1) {
+		perror("socket");
+		return -1;
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+
+	/* cleanup after past failures */
+	unlink(path);
+
+	if (bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) == -1) {
+		perror("bind");
+		close(listen_fd);
+		return -1;
+	}
+
+	if (listen(listen_fd, SOMAXCONN) == -1 || set_nonblocking(listen_fd) == -1) {
+		perror("listen");
+		close(listen_fd);
+		return -1;
+	}
+
+	if ((epoll_fd = epoll_create1(0)) == -1) {
+		perror("epoll_create1");
+		close(listen_fd);
+		return -1;
+	}
+
+	ev.events = EPOLLIN | EPOLLONESHOT;
+	ev.data.ptr = &listener_tag;
+	if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &ev) == -1) {
+		perror("epoll_ctl");
+		close(epoll_fd);
+		close(listen_fd);
+		return -1;
+	}
+
+	for (i = 0; i < nworkers; i++) {
+		if (pthread_create(&workers[i], NULL, worker_run, NULL)) {
+			fprintf(stderr, "Error creating worker thread\n");
+			break;
+		}
+	}
+	num_workers = i;
+	if (num_workers == 0)
+		return -1;
+
+	printf("Listening on %s with %d worker threads.\n", path, num_workers);
+	return 0;
+}
+
+/* Blocks until the worker threads exit (they normally never do). */
+void sockserver_join(void)
+{
+	int i;
+
+	for (i = 0; i < num_workers; i++)
+		pthread_join(workers[i], NULL);
+}
+
+/* Code executed by each worker: wait for ready descriptors and serve
+ * them.  Thanks to EPOLLONESHOT, an event is delivered to exactly one
+ * worker, which re-arms the descriptor once it is done with it. */
+static void *worker_run(void *arg)
+{
+	struct epoll_event events[MAX_EVENTS];
+	int n;
+	int i;
+
+	(void)arg;
+
+	while (1) {
+		n = epoll_wait(epoll_fd, events, MAX_EVENTS, -1);
+		if (n == -1) {
+			if (errno == EINTR)
+				continue;
+			perror("epoll_wait");
+			return 0;
+		}
+
+		for (i = 0; i < n; i++) {
+			if (events[i].data.ptr == &listener_tag)
+				accept_clients();
+			else
+				conn_service((conn_t *) events[i].data.ptr,
+					     events[i].events);
+		}
+	}
+
+	return 0;
+}
+
+static void accept_clients(void)
+{
+	struct epoll_event ev;
+	conn_t *conn;
+	int fd;
+
+	while ((fd = accept(listen_fd, NULL, NULL)) != -1) {
+		if (set_nonblocking(fd) == -1
+		    || (conn = (conn_t *) calloc(1, sizeof(conn_t))) == 0) {
+			close(fd);
+			continue;
+		}
+		conn->fd = fd;
+
+		ev.events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+		ev.data.ptr = conn;
+		if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+			perror("epoll_ctl");
+			close(fd);
+			free(conn);
+		}
+	}
+
+	if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+		perror("accept");
+
+	/* re-arm the listener */
+	ev.events = EPOLLIN | EPOLLONESHOT;
+	ev.data.ptr = &listener_tag;
+	epoll_ctl(epoll_fd, EPOLL_CTL_MOD, listen_fd, &ev);
+}
+
+/* Handles readiness EVENTS on CONN: drains pending output, then reads
+ * and executes every complete command that has arrived, and finally
+ * sends all of the responses with as few writes as possible. */
+static void conn_service(conn_t *conn, unsigned int events)
+{
+	if (events & EPOLLERR) {
+		conn_destroy(conn);
+		return;
+	}
+
+	if (conn_flush(conn) == -1) {
+		conn_destroy(conn);
+		return;
+	}
+
+	if (conn->outlen - conn->outoff < CONN_OUT_HIGH) {
+		if (conn_read(conn) == -1) {
+			/* peer went away; still try to deliver what it asked for */
+			conn_flush(conn);
+			conn_destroy(conn);
+			return;
+		}
+		if (conn_flush(conn) == -1) {
+			conn_destroy(conn);
+			return;
+		}
+	}
+
+	conn_rearm(conn);
+}
+
+/* Reads what is available (up to READS_PER_WAKEUP reads) and executes
+ * the complete commands found.  Returns -1 on EOF or error. */
+static int conn_read(conn_t *conn)
+{
+	int reads;
+	int ret;
+
+	for (reads = 0; reads < READS_PER_WAKEUP; reads++) {
+		ret = read(conn->fd, conn->in + conn->inlen,
+			   sizeof(conn->in) - conn->inlen);
+		if (ret == -1) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				return 0;
+			return -1;
+		}
+		if (ret == 0) {
+			conn_execute(conn);
+			return -1;
+		}
+		conn->inlen += ret;
+		conn_execute(conn);
+
+		if (conn->outlen - conn->outoff >= CONN_OUT_HIGH)
+			return 0;
+	}
+
+	return 0;
+}
+
+/* Executes every newline-terminated command in the input buffer,
+ * appending one response line per command to the output buffer. */
+static void conn_execute(conn_t *conn)
+{
+	char response[CONN_RESPONSE];
+	char scan_response[CONN_SCAN_RESPONSE];
+	char *start = conn->in;
+	char *end = conn->in + conn->inlen;
+	char *nl;
+
+	while ((nl = memchr(start, '\n', end - start)) != 0) {
+		*nl = '\0';
+		if (nl > start && nl[-1] == '\r')
+			nl[-1] = '\0';
+
+		if (start[0] == 'r' || start[0] == 'p') {
+			/* scans terminate their responses themselves */
+			scan_response[0] = '\0';
+			handle_command(start, scan_response, sizeof(scan_response));
+			conn_append(conn, scan_response, strlen(scan_response));
+		} else {
+			memset(response, 0, sizeof(response));
+			handle_command(start, response, sizeof(response));
+			conn_append(conn, response, strlen(response));
+		}
+		conn_append(conn, "\n", 1);
+
+		start = nl + 1;
+	}
+
+	if (start == conn->in && conn->inlen == sizeof(conn->in)) {
+		/* a full buffer without a newline can never become a
+		 * valid command; throw it away */
+		conn_append(conn, "ill-formed command\n", 19);
+		conn->inlen = 0;
+		return;
+	}
+
+	conn->inlen = end - start;
+	memmove(conn->in, start, conn->inlen);
+}
+
+static int conn_append(conn_t *conn, const char *data, int len)
+{
+	char *grown;
+	int cap;
+
+	if (conn->outoff > 0 && conn->outoff == conn->outlen)
+		conn->outoff = conn->outlen = 0;
+
+	if (conn->outlen + len > conn->outcap) {
+		cap = conn->outcap ? conn->outcap : CONN_INBUF;
+		while (cap < conn->outlen + len)
+			cap *= 2;
+		if ((grown = (char *)realloc(conn->out, cap)) == 0)
+			return -1;
+		conn->out = grown;
+		conn->outcap = cap;
+	}
+
+	memcpy(conn->out + conn->outlen, data, len);
+	conn->outlen += len;
+	return 0;
+}
+
+/* Writes as much pending output as the socket accepts.  Returns -1 if
+ * the connection is broken. */
+static int conn_flush(conn_t *conn)
+{
+	int ret;
+
+	while (conn->outoff < conn->outlen) {
+		ret = write(conn->fd, conn->out + conn->outoff,
+			    conn->outlen - conn->outoff);
+		if (ret == -1) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				return 0;
+			return -1;
+		}
+		conn->outoff += ret;
+	}
+
+	conn->outoff = conn->outlen = 0;
+	return 0;
+}
+
+static void conn_rearm(conn_t *conn)
+{
+	struct epoll_event ev;
+
+	ev.events = EPOLLRDHUP | EPOLLONESHOT;
+	if (conn->outlen - conn->outoff < CONN_OUT_HIGH)
+		ev.events |= EPOLLIN;
+	if (conn->outoff < conn->outlen)
+		ev.events |= EPOLLOUT;
+	ev.data.ptr = conn;
+
+	if (epoll_ctl(epoll_fd, EPOLL_CTL_MOD, conn->fd, &ev) == -1)
+		conn_destroy(conn);
+}
+
+static void conn_destroy(conn_t *conn)
+{
+	epoll_ctl(epoll_fd, EPOLL_CTL_DEL, conn->fd, NULL);
+	close(conn->fd);
+	free(conn->out);
+	free(conn);
+}
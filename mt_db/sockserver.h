@@ -0,0 +1,12 @@
+/* Headless front end for the database: clients connect over a Unix
+ * domain socket and send newline-terminated commands, which are
+ * multiplexed with epoll across a small fixed pool of worker threads. */
+
+#define SOCKSERVER_DEFAULT_PATH "/tmp/mt_db.sock"
+#define SOCKSERVER_DEFAULT_WORKERS 4
+
+int sockserver_start(const char *, int);
+void sockserver_join(void);
+
+/* provided by server.c */
+int handle_command(char *, char *, int);
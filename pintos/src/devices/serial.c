@@ -1,7 +1,6 @@
 #include "devices/serial.h"
 #include <debug.h>
 #include "devices/input.h"
-#include "devices/intq.h"
 #include "devices/timer.h"
 #include "threads/io.h"
 #include "threads/interrupt.h"
@@ -33,6 +32,16 @@
 #define MCR_REG (IO_BASE + 4)   /* MODEM Control Register. */
 #define LSR_REG (IO_BASE + 5)   /* Line Status Register (read-only). */
 
+/* FIFO Control Register bits. */
+#define FCR_ENABLE 0x01         /* Enable receive and transmit FIFOs. */
+#define FCR_CLEAR_RECV 0x02     /* Clear receive FIFO. */
+#define FCR_CLEAR_XMIT 0x04     /* Clear transmit FIFO. */
+#define FCR_TRIGGER_1 0x00      /* Receive interrupt after 1 byte. */
+
+/* Size of the 16550A's transmit FIFO, in bytes.  When THRE is set
+   the FIFO is empty, so this many bytes may be written at once. */
+#define XMIT_FIFO_SIZE 16
+
 /* Interrupt Enable Register bits. */
 #define IER_RECV 0x01           /* Interrupt when data received. */
 #define IER_XMIT 0x02           /* Interrupt when transmit finishes. */
@@ -51,11 +60,24 @@
 /* Transmission mode. */
 static enum { UNINIT, POLL, QUEUE } mode;
 
-/* Data to be transmitted. */
-static struct intq txq;
+/* Data to be transmitted, a circular buffer filled by kernel
+   threads and drained a FIFO's worth at a time by the interrupt
+   handler.  HEAD and TAIL count bytes ever added and removed, so
+   they index the buffer modulo TXQ_SIZE, which must be a power of
+   2.  Like an intq, at most one thread waits for room at a time. */
+#define TXQ_SIZE 4096
+static uint8_t txq[TXQ_SIZE];
+static size_t txq_head;         /* New data is written here. */
+static size_t txq_tail;         /* Old data is read here. */
+static struct lock txq_lock;    /* Only one thread may wait at once. */
+static struct thread *txq_waiter; /* Thread waiting for room. */
 
 static void set_serial (int bps);
 static void putc_poll (uint8_t);
+static void putc_queue (uint8_t, enum intr_level);
+static void xmit_fifo (void);
+static bool txq_empty (void);
+static bool txq_full (void);
 static void write_ier (void);
 static intr_handler_func serial_interrupt;
 
@@ -68,10 +90,11 @@ init_poll (void)
 {
   ASSERT (mode == UNINIT);
   outb (IER_REG, 0);                    /* Turn off all interrupts. */
-  outb (FCR_REG, 0);                    /* Disable FIFO. */
+  outb (FCR_REG, FCR_ENABLE | FCR_CLEAR_RECV | FCR_CLEAR_XMIT
+        | FCR_TRIGGER_1);               /* Enable and clear FIFOs. */
   set_serial (9600);                    /* 9.6 kbps, N-8-1. */
   outb (MCR_REG, MCR_OUT2);             /* Required to enable interrupts. */
-  intq_init (&txq);
+  lock_init (&txq_lock);
   mode = POLL;
 } 
 
@@ -112,17 +135,42 @@ serial_putc (uint8_t byte)
     {
       /* Otherwise, queue a byte and update the interrupt enable
          register. */
-      if (old_level == INTR_OFF && intq_full (&txq)) 
+      putc_queue (byte, old_level);
+      write_ier ();
+    }
+  
+  intr_set_level (old_level);
+}
+
+/* Sends the N bytes in BUFFER to the serial port, like calling
+   serial_putc() for each, but with interrupts disabled once for the
+   whole buffer and the interrupt enable register written only at
+   the end.  The interrupt handler sends the bytes out while the
+   caller goes on.  In polling mode, the transmit FIFO is filled
+   each time it empties instead of waiting on every byte. */
+void
+serial_putbuf (const char *buffer, size_t n) 
+{
+  enum intr_level old_level = intr_disable ();
+
+  if (mode != QUEUE)
+    {
+      if (mode == UNINIT)
+        init_poll ();
+      while (n > 0)
         {
-          /* Interrupts are off and the transmit queue is full.
-             If we wanted to wait for the queue to empty,
-             we'd have to reenable interrupts.
-             That's impolite, so we'll send a character via
-             polling instead. */
-          putc_poll (intq_getc (&txq)); 
-        }
+          size_t i;
 
-      intq_putc (&txq, byte); 
+          while ((inb (LSR_REG) & LSR_THRE) == 0)
+            continue;
+          for (i = 0; i < XMIT_FIFO_SIZE && n > 0; i++, n--)
+            outb (THR_REG, *buffer++);
+        }
+    }
+  else 
+    {
+      while (n-- > 0)
+        putc_queue (*buffer++, old_level);
       write_ier ();
     }
   
@@ -135,8 +183,12 @@ void
 serial_flush (void) 
 {
   enum intr_level old_level = intr_disable ();
-  while (!intq_empty (&txq))
-    putc_poll (intq_getc (&txq));
+  while (!txq_empty ())
+    {
+      while ((inb (LSR_REG) & LSR_THRE) == 0)
+        continue;
+      xmit_fifo ();
+    }
   intr_set_level (old_level);
 }
 
@@ -182,7 +234,7 @@ write_ier (void)
 
   /* Enable transmit interrupt if we have any characters to
      transmit. */
-  if (!intq_empty (&txq))
+  if (!txq_empty ())
     ier |= IER_XMIT;
 
   /* Enable receive interrupt if we have room to store any
@@ -205,6 +257,76 @@ putc_poll (uint8_t byte)
   outb (THR_REG, byte);
 }
 
+/* Adds BYTE to the transmit queue.  If the queue is full and
+   interrupts were on before the caller disabled them (OLD_LEVEL),
+   sleeps until the interrupt handler makes room.  If they were off,
+   waiting would mean reenabling them, which is impolite, so the
+   oldest bytes are sent via polling instead. */
+static void
+putc_queue (uint8_t byte, enum intr_level old_level) 
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  while (txq_full ()) 
+    {
+      if (old_level == INTR_OFF)
+        {
+          while ((inb (LSR_REG) & LSR_THRE) == 0)
+            continue;
+          xmit_fifo ();
+        }
+      else
+        {
+          /* Make sure the transmit interrupt is on to wake us. */
+          write_ier ();
+          lock_acquire (&txq_lock);
+          if (txq_full ())
+            {
+              txq_waiter = thread_current ();
+              thread_block ();
+            }
+          lock_release (&txq_lock);
+        }
+    }
+
+  txq[txq_head++ % TXQ_SIZE] = byte;
+}
+
+/* Moves up to a FIFO's worth of bytes from the transmit queue into
+   the UART, which must have THRE set.  A thread waiting for room
+   is woken once the queue is half empty, so that it can refill it
+   in one go instead of a FIFO's worth at a time. */
+static void
+xmit_fifo (void) 
+{
+  int i;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  for (i = 0; i < XMIT_FIFO_SIZE && !txq_empty (); i++)
+    outb (THR_REG, txq[txq_tail++ % TXQ_SIZE]);
+
+  if (txq_waiter != NULL && txq_head - txq_tail <= TXQ_SIZE / 2) 
+    {
+      thread_unblock (txq_waiter);
+      txq_waiter = NULL;
+    }
+}
+
+/* Returns true if the transmit queue is empty. */
+static bool
+txq_empty (void) 
+{
+  return txq_head == txq_tail;
+}
+
+/* Returns true if the transmit queue is full. */
+static bool
+txq_full (void) 
+{
+  return txq_head - txq_tail == TXQ_SIZE;
+}
+
 /* Serial interrupt handler. */
 static void
 serial_interrupt (struct intr_frame *f UNUSED) 
@@ -218,10 +340,11 @@ serial_interrupt (struct intr_frame *f UNUSED)
   while (!input_full () && (inb (LSR_REG) & LSR_DR) != 0)
     input_putc (inb (RBR_REG));
 
-  /* As long as we have a byte to transmit, and the hardware is
-     ready to accept a byte for transmission, transmit a byte. */
-  while (!intq_empty (&txq) && (inb (LSR_REG) & LSR_THRE) != 0) 
-    outb (THR_REG, intq_getc (&txq));
+  /* If the transmit FIFO has drained, refill it from the queue.
+     Checking THRE once per interrupt is enough: the UART raises
+     another interrupt when the FIFO empties again. */
+  if ((inb (LSR_REG) & LSR_THRE) != 0)
+    xmit_fifo ();
 
   /* Update interrupt enable register based on queue status. */
   write_ier ();
@@ -31,6 +31,7 @@ static void cls (void);
 static void newline (void);
 static void move_cursor (void);
 static void find_cursor (size_t *x, size_t *y);
+static void putc_have_intr_off (int c, enum intr_level *old_level);
 
 /* Initializes the VGA text display. */
 static void
@@ -56,7 +57,46 @@ vga_putc (int c)
   enum intr_level old_level = intr_disable ();
 
   init ();
-  
+  putc_have_intr_off (c, &old_level);
+
+  /* Update cursor position. */
+  move_cursor ();
+
+  intr_set_level (old_level);
+}
+
+/* Writes the N characters in BUFFER to the VGA text display, like
+   calling vga_putc() for each.  Interrupts are disabled and the
+   hardware cursor moved once per line rather than per character. */
+void
+vga_putbuf (const char *buffer, size_t n)
+{
+  const char *end = buffer + n;
+
+  while (buffer < end)
+    {
+      enum intr_level old_level = intr_disable ();
+
+      init ();
+      while (buffer < end)
+        {
+          char c = *buffer++;
+          putc_have_intr_off (c, &old_level);
+          if (c == '\n')
+            break;
+        }
+      move_cursor ();
+
+      intr_set_level (old_level);
+    }
+}
+
+/* Writes C to the framebuffer, without moving the hardware cursor.
+   Interrupts must be off; *OLD_LEVEL is the level to restore around
+   a beep. */
+static void
+putc_have_intr_off (int c, enum intr_level *old_level)
+{
   switch (c) 
     {
     case '\n':
@@ -83,7 +123,7 @@ vga_putc (int c)
       break;
 
     case '\a':
-      intr_set_level (old_level);
+      intr_set_level (*old_level);
       speaker_beep ();
       intr_disable ();
       break;
@@ -95,11 +135,6 @@ vga_putc (int c)
         newline ();
       break;
     }
-
-  /* Update cursor position. */
-  move_cursor ();
-
-  intr_set_level (old_level);
 }
 
 /* Clears the screen and moves the cursor to the upper left. */
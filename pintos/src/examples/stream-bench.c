@@ -0,0 +1,119 @@
+/* stream-bench.c
+
+   Copies a 1 MB file and then reads the copy back, RECORD_SIZE
+   bytes at a time, through either unbuffered or buffered
+   streams, to compare the two.  Run it once each way on a file
+   system with room for two 1 MB files, e.g.
+
+       pintos --filesys-size=4 -- -f -q run 'stream-bench raw'
+       pintos --filesys-size=4 -- -f -q run 'stream-bench buffered'
+
+   and compare the "Timer" and "Syscall" lines printed at power
+   off.  Unbuffered streams make one system call per record, like
+   a program calling read() and write() directly; buffered
+   streams make one per BUFSIZ bytes. */
+
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+
+/* Size of the files. */
+#define FILE_SIZE (1024 * 1024)
+
+/* Bytes moved per call. */
+#define RECORD_SIZE 16
+
+static void make_file (const char *name);
+static FILE *open_stream (const char *name, const char *mode, bool buffered);
+
+int
+main (int argc, char *argv[])
+{
+  FILE *in, *out;
+  char record[RECORD_SIZE];
+  unsigned sum, size;
+  bool buffered;
+
+  if (argc != 2 || (strcmp (argv[1], "raw") && strcmp (argv[1], "buffered")))
+    {
+      printf ("usage: stream-bench raw|buffered\n");
+      return EXIT_FAILURE;
+    }
+  buffered = !strcmp (argv[1], "buffered");
+  make_file ("bench.in");
+
+  /* cp. */
+  in = open_stream ("bench.in", "r", buffered);
+  if (!create ("bench.out", FILE_SIZE))
+    {
+      printf ("bench.out: create failed\n");
+      return EXIT_FAILURE;
+    }
+  out = open_stream ("bench.out", "w", buffered);
+  while (fread (record, RECORD_SIZE, 1, in) == 1)
+    if (fwrite (record, RECORD_SIZE, 1, out) != 1)
+      {
+        printf ("bench.out: write failed\n");
+        return EXIT_FAILURE;
+      }
+  fclose (in);
+  if (fclose (out) != 0)
+    {
+      printf ("bench.out: write failed\n");
+      return EXIT_FAILURE;
+    }
+
+  /* cat, into a checksum rather than the console. */
+  in = open_stream ("bench.out", "r", buffered);
+  sum = size = 0;
+  while (fread (record, RECORD_SIZE, 1, in) == 1)
+    {
+      int i;
+
+      for (i = 0; i < RECORD_SIZE; i++)
+        sum = sum * 31 + (unsigned char) record[i];
+      size += RECORD_SIZE;
+    }
+  fclose (in);
+
+  printf ("stream-bench %s: copied and read %u bytes, checksum %08x\n",
+          argv[1], size, sum);
+  return size == FILE_SIZE ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* Creates NAME holding FILE_SIZE bytes of a repeating pattern,
+   written a page at a time. */
+static void
+make_file (const char *name)
+{
+  static char page[4096];
+  FILE *f;
+  int i;
+
+  for (i = 0; i < (int) sizeof page; i++)
+    page[i] = i * 7 + i / 256;
+  if (!create (name, FILE_SIZE) || (f = fopen (name, "w")) == NULL)
+    {
+      printf ("%s: create failed\n", name);
+      exit (EXIT_FAILURE);
+    }
+  for (i = 0; i < FILE_SIZE / (int) sizeof page; i++)
+    fwrite (page, sizeof page, 1, f);
+  fclose (f);
+}
+
+/* Opens NAME with MODE as a stream, unbuffered unless BUFFERED
+   is true.  Exits on failure. */
+static FILE *
+open_stream (const char *name, const char *mode, bool buffered)
+{
+  FILE *f = fopen (name, mode);
+  if (f == NULL)
+    {
+      printf ("%s: open failed\n", name);
+      exit (EXIT_FAILURE);
+    }
+  if (!buffered)
+    setbuffer (f, NULL, 0);
+  return f;
+}
@@ -69,6 +69,36 @@ last_mask (const struct bitmap *b)
   return last_bits ? ((elem_type) 1 << last_bits) - 1 : (elem_type) -1;
 }
 
+/* Returns the index of the first bit in B at or after START that
+   is set to VALUE, or B's size if there is none.  Skips elements
+   that hold no such bit and uses bsf to find the bit within the
+   first element that does. */
+static size_t
+find_bit (const struct bitmap *b, size_t start, bool value) 
+{
+  elem_type flip = value ? 0 : (elem_type) -1;
+  size_t last = elem_cnt (b->bit_cnt);
+  size_t i = elem_idx (start);
+  elem_type elem;
+
+  if (start >= b->bit_cnt)
+    return b->bit_cnt;
+
+  /* Ignore the bits below START in its element. */
+  elem = (b->bits[i] ^ flip) & ~(bit_mask (start) - 1);
+  while (elem == 0)
+    {
+      if (++i >= last)
+        return b->bit_cnt;
+      elem = b->bits[i] ^ flip;
+    }
+
+  /* The unused bits past the end of the last element are
+     undefined, so the result may lie beyond B's size. */
+  start = i * ELEM_BITS + __builtin_ctzl (elem);
+  return start < b->bit_cnt ? start : b->bit_cnt;
+}
+
 /* Creation and destruction. */
 
 /* Creates and returns a pointer to a newly allocated bitmap with room for
@@ -223,7 +253,16 @@ bitmap_set_multiple (struct bitmap *b, size_t start, size_t cnt, bool value)
   ASSERT (start <= b->bit_cnt);
   ASSERT (start + cnt <= b->bit_cnt);
 
-  for (i = 0; i < cnt; i++)
+  /* Bits up to the first element boundary. */
+  for (i = 0; i < cnt && (start + i) % ELEM_BITS != 0; i++)
+    bitmap_set (b, start + i, value);
+
+  /* Whole elements. */
+  for (; cnt - i >= ELEM_BITS; i += ELEM_BITS)
+    b->bits[elem_idx (start + i)] = value ? (elem_type) -1 : 0;
+
+  /* Bits past the last whole element. */
+  for (; i < cnt; i++)
     bitmap_set (b, start + i, value);
 }
 
@@ -250,16 +289,11 @@ bitmap_count (const struct bitmap *b, size_t start, size_t cnt, bool value)
 bool
 bitmap_contains (const struct bitmap *b, size_t start, size_t cnt, bool value) 
 {
-  size_t i;
-  
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
   ASSERT (start + cnt <= b->bit_cnt);
 
-  for (i = 0; i < cnt; i++)
-    if (bitmap_test (b, start + i) == value)
-      return true;
-  return false;
+  return cnt > 0 && find_bit (b, start, value) < start + cnt;
 }
 
 /* Returns true if any bits in B between START and START + CNT,
@@ -298,13 +332,24 @@ bitmap_scan (const struct bitmap *b, size_t start, size_t cnt, bool value)
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
 
-  if (cnt <= b->bit_cnt) 
+  if (cnt == 0)
+    return start;
+
+  /* Jump to the next bit set to VALUE, then to the end of its run.
+     Both jumps skip whole elements at a time, so the cost is
+     proportional to the number of runs, not to the number of
+     candidate positions. */
+  while (start < b->bit_cnt) 
     {
-      size_t last = b->bit_cnt - cnt;
-      size_t i;
-      for (i = start; i <= last; i++)
-        if (!bitmap_contains (b, i, cnt, !value))
-          return i; 
+      size_t end;
+
+      start = find_bit (b, start, value);
+      if (cnt > b->bit_cnt - start)
+        break;
+      end = find_bit (b, start, !value);
+      if (end - start >= cnt)
+        return start;
+      start = end;
     }
   return BITMAP_ERROR;
 }
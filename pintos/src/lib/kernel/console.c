@@ -1,14 +1,25 @@
 #include <console.h>
 #include <stdarg.h>
 #include <stdio.h>
+#include <string.h>
 #include "devices/serial.h"
 #include "devices/vga.h"
 #include "threads/init.h"
 #include "threads/interrupt.h"
 #include "threads/synch.h"
 
+/* Auxiliary data for vprintf_helper(). */
+struct vprintf_aux
+  {
+    char buf[128];      /* Character buffer. */
+    char *p;            /* Current position in buffer. */
+    int char_cnt;       /* Total characters written so far. */
+  };
+
 static void vprintf_helper (char, void *);
+static void vprintf_flush (struct vprintf_aux *);
 static void putchar_have_lock (uint8_t c);
+static void putbuf_have_lock (const char *buffer, size_t n);
 
 /* The console lock.
    Both the vga and serial layers do their own locking, so it's
@@ -121,17 +132,22 @@ console_locked_by_current_thread (void)
 
 /* The standard vprintf() function,
    which is like printf() but uses a va_list.
-   Writes its output to both vga display and serial port. */
+   Writes its output to both vga display and serial port.
+   The output is collected in a buffer and handed to the devices
+   a buffer at a time, usually once per call. */
 int
 vprintf (const char *format, va_list args) 
 {
-  int char_cnt = 0;
+  struct vprintf_aux aux;
 
+  aux.p = aux.buf;
+  aux.char_cnt = 0;
   acquire_console ();
-  __vprintf (format, args, vprintf_helper, &char_cnt);
+  __vprintf (format, args, vprintf_helper, &aux);
+  vprintf_flush (&aux);
   release_console ();
 
-  return char_cnt;
+  return aux.char_cnt;
 }
 
 /* Writes string S to the console, followed by a new-line
@@ -140,8 +156,7 @@ int
 puts (const char *s) 
 {
   acquire_console ();
-  while (*s != '\0')
-    putchar_have_lock (*s++);
+  putbuf_have_lock (s, strlen (s));
   putchar_have_lock ('\n');
   release_console ();
 
@@ -153,8 +168,7 @@ void
 putbuf (const char *buffer, size_t n) 
 {
   acquire_console ();
-  while (n-- > 0)
-    putchar_have_lock (*buffer++);
+  putbuf_have_lock (buffer, n);
   release_console ();
 }
 
@@ -169,13 +183,27 @@ putchar (int c)
   return c;
 }
 
-/* Helper function for vprintf(). */
+/* Helper function for vprintf().  Adds C to the buffer in AUX,
+   flushing it if the buffer fills up. */
 static void
-vprintf_helper (char c, void *char_cnt_) 
+vprintf_helper (char c, void *aux_) 
 {
-  int *char_cnt = char_cnt_;
-  (*char_cnt)++;
-  putchar_have_lock (c);
+  struct vprintf_aux *aux = aux_;
+  *aux->p++ = c;
+  if (aux->p >= aux->buf + sizeof aux->buf)
+    vprintf_flush (aux);
+  aux->char_cnt++;
+}
+
+/* Writes out the buffer in AUX.
+   The caller has already acquired the console lock if
+   appropriate. */
+static void
+vprintf_flush (struct vprintf_aux *aux)
+{
+  if (aux->p > aux->buf)
+    putbuf_have_lock (aux->buf, aux->p - aux->buf);
+  aux->p = aux->buf;
 }
 
 /* Writes C to the vga display and serial port.
@@ -189,3 +217,16 @@ putchar_have_lock (uint8_t c)
   serial_putc (c);
   vga_putc (c);
 }
+
+/* Writes the N characters in BUFFER to the vga display and serial
+   port, handing each device the whole buffer at once.
+   The caller has already acquired the console lock if
+   appropriate. */
+static void
+putbuf_have_lock (const char *buffer, size_t n) 
+{
+  ASSERT (console_locked_by_current_thread ());
+  write_cnt += n;
+  serial_putbuf (buffer, n);
+  vga_putbuf (buffer, n);
+}
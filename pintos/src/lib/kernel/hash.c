@@ -6,18 +6,35 @@
    See hash.h for basic information. */
 
 #include "hash.h"
+#include <string.h>
 #include "../debug.h"
 #include "threads/malloc.h"
 
-#define list_elem_to_hash_elem(LIST_ELEM)                       \
-        list_entry(LIST_ELEM, struct hash_elem, list_elem)
+/* Fewest slots a table has. */
+#define MIN_SLOTS 8
 
-static struct list *find_bucket (struct hash *, struct hash_elem *);
-static struct hash_elem *find_elem (struct hash *, struct list *,
+/* Old slots moved into the new array by each insertion,
+   replacement, or deletion while a table is being resized.
+   Resizing must finish before the new array fills up; see
+   needs_resize(). */
+#define MOVE_SLOTS 8
+
+/* Marks an old slot whose element has been moved or deleted.
+   Unlike an empty slot, it doesn't end a search. */
+static struct hash_elem moved;
+#define MOVED (&moved)
+
+static bool equal (struct hash *, struct hash_slot *, unsigned hash,
+                   struct hash_elem *);
+static struct hash_slot *find_slot (struct hash *, unsigned hash,
                                     struct hash_elem *);
-static void insert_elem (struct hash *, struct list *, struct hash_elem *);
-static void remove_elem (struct hash *, struct hash_elem *);
-static void rehash (struct hash *);
+static struct hash_slot *find_old_slot (struct hash *, unsigned hash,
+                                        struct hash_elem *);
+static void put_elem (struct hash *, unsigned hash, struct hash_elem *);
+static void remove_slot (struct hash *, struct hash_slot *);
+static struct hash_slot *iter_slot (struct hash *, size_t idx);
+static void move_slots (struct hash *, size_t cnt);
+static void resize (struct hash *);
 
 /* Initializes hash table H to compute hash values using HASH and
    compare hash elements using LESS, given auxiliary data AUX. */
@@ -26,19 +43,17 @@ hash_init (struct hash *h,
            hash_hash_func *hash, hash_less_func *less, void *aux) 
 {
   h->elem_cnt = 0;
-  h->bucket_cnt = 4;
-  h->buckets = malloc (sizeof *h->buckets * h->bucket_cnt);
+  h->slot_cnt = MIN_SLOTS;
+  h->used_cnt = 0;
+  h->slots = calloc (h->slot_cnt, sizeof *h->slots);
+  h->old_cnt = 0;
+  h->old_idx = 0;
+  h->old_slots = NULL;
   h->hash = hash;
   h->less = less;
   h->aux = aux;
 
-  if (h->buckets != NULL) 
-    {
-      hash_clear (h, NULL);
-      return true;
-    }
-  else
-    return false;
+  return h->slots != NULL;
 }
 
 /* Removes all the elements from H.
@@ -53,23 +68,14 @@ hash_init (struct hash *h,
 void
 hash_clear (struct hash *h, hash_action_func *destructor) 
 {
-  size_t i;
-
-  for (i = 0; i < h->bucket_cnt; i++) 
-    {
-      struct list *bucket = &h->buckets[i];
-
-      if (destructor != NULL) 
-        while (!list_empty (bucket)) 
-          {
-            struct list_elem *list_elem = list_pop_front (bucket);
-            struct hash_elem *hash_elem = list_elem_to_hash_elem (list_elem);
-            destructor (hash_elem, h->aux);
-          }
-
-      list_init (bucket); 
-    }    
+  if (destructor != NULL)
+    hash_apply (h, destructor);
 
+  free (h->old_slots);
+  h->old_slots = NULL;
+  h->old_cnt = h->old_idx = 0;
+  memset (h->slots, 0, h->slot_cnt * sizeof *h->slots);
+  h->used_cnt = 0;
   h->elem_cnt = 0;
 }
 
@@ -87,8 +93,9 @@ void
 hash_destroy (struct hash *h, hash_action_func *destructor) 
 {
   if (destructor != NULL)
-    hash_clear (h, destructor);
-  free (h->buckets);
+    hash_apply (h, destructor);
+  free (h->old_slots);
+  free (h->slots);
 }
 
 /* Inserts NEW into hash table H and returns a null pointer, if
@@ -98,15 +105,22 @@ hash_destroy (struct hash *h, hash_action_func *destructor)
 struct hash_elem *
 hash_insert (struct hash *h, struct hash_elem *new)
 {
-  struct list *bucket = find_bucket (h, new);
-  struct hash_elem *old = find_elem (h, bucket, new);
+  unsigned hash = h->hash (new, h->aux);
+  struct hash_slot *slot;
+
+  move_slots (h, MOVE_SLOTS);
 
-  if (old == NULL) 
-    insert_elem (h, bucket, new);
+  slot = find_slot (h, hash, new);
+  if (slot == NULL)
+    slot = find_old_slot (h, hash, new);
+  if (slot != NULL)
+    return slot->elem;
 
-  rehash (h);
+  put_elem (h, hash, new);
+  h->elem_cnt++;
+  resize (h);
 
-  return old; 
+  return NULL; 
 }
 
 /* Inserts NEW into hash table H, replacing any equal element
@@ -114,14 +128,36 @@ hash_insert (struct hash *h, struct hash_elem *new)
 struct hash_elem *
 hash_replace (struct hash *h, struct hash_elem *new) 
 {
-  struct list *bucket = find_bucket (h, new);
-  struct hash_elem *old = find_elem (h, bucket, new);
+  unsigned hash = h->hash (new, h->aux);
+  struct hash_slot *slot;
+  struct hash_elem *old;
 
-  if (old != NULL)
-    remove_elem (h, old);
-  insert_elem (h, bucket, new);
+  move_slots (h, MOVE_SLOTS);
+
+  /* An equal element in the current array is replaced in its
+     slot.  One in the old array is removed from there instead,
+     and NEW goes into the current array. */
+  slot = find_slot (h, hash, new);
+  if (slot != NULL)
+    {
+      old = slot->elem;
+      slot->elem = new;
+      return old;
+    }
 
-  rehash (h);
+  slot = find_old_slot (h, hash, new);
+  if (slot != NULL)
+    {
+      old = slot->elem;
+      slot->elem = MOVED;
+    }
+  else
+    {
+      old = NULL;
+      h->elem_cnt++;
+    }
+  put_elem (h, hash, new);
+  resize (h);
 
   return old;
 }
@@ -131,7 +167,12 @@ hash_replace (struct hash *h, struct hash_elem *new)
 struct hash_elem *
 hash_find (struct hash *h, struct hash_elem *e) 
 {
-  return find_elem (h, find_bucket (h, e), e);
+  unsigned hash = h->hash (e, h->aux);
+  struct hash_slot *slot = find_slot (h, hash, e);
+
+  if (slot == NULL)
+    slot = find_old_slot (h, hash, e);
+  return slot != NULL ? slot->elem : NULL;
 }
 
 /* Finds, removes, and returns an element equal to E in hash
@@ -144,11 +185,32 @@ hash_find (struct hash *h, struct hash_elem *e)
 struct hash_elem *
 hash_delete (struct hash *h, struct hash_elem *e)
 {
-  struct hash_elem *found = find_elem (h, find_bucket (h, e), e);
+  unsigned hash = h->hash (e, h->aux);
+  struct hash_slot *slot;
+  struct hash_elem *found = NULL;
+
+  move_slots (h, MOVE_SLOTS);
+
+  slot = find_slot (h, hash, e);
+  if (slot != NULL)
+    {
+      found = slot->elem;
+      remove_slot (h, slot);
+    }
+  else
+    {
+      slot = find_old_slot (h, hash, e);
+      if (slot != NULL)
+        {
+          found = slot->elem;
+          slot->elem = MOVED;
+        }
+    }
+
   if (found != NULL) 
     {
-      remove_elem (h, found);
-      rehash (h); 
+      h->elem_cnt--;
+      resize (h); 
     }
   return found;
 }
@@ -162,21 +224,13 @@ hash_delete (struct hash *h, struct hash_elem *e)
 void
 hash_apply (struct hash *h, hash_action_func *action) 
 {
-  size_t i;
+  struct hash_iterator i;
   
   ASSERT (action != NULL);
 
-  for (i = 0; i < h->bucket_cnt; i++) 
-    {
-      struct list *bucket = &h->buckets[i];
-      struct list_elem *elem, *next;
-
-      for (elem = list_begin (bucket); elem != list_end (bucket); elem = next) 
-        {
-          next = list_next (elem);
-          action (list_elem_to_hash_elem (elem), h->aux);
-        }
-    }
+  hash_first (&i, h);
+  while (hash_next (&i))
+    action (hash_cur (&i), h->aux);
 }
 
 /* Initializes I for iterating hash table H.
@@ -203,8 +257,8 @@ hash_first (struct hash_iterator *i, struct hash *h)
   ASSERT (h != NULL);
 
   i->hash = h;
-  i->bucket = i->hash->buckets;
-  i->elem = list_elem_to_hash_elem (list_head (i->bucket));
+  i->idx = 0;
+  i->elem = NULL;
 }
 
 /* Advances I to the next element in the hash table and returns
@@ -218,17 +272,19 @@ hash_first (struct hash_iterator *i, struct hash *h)
 struct hash_elem *
 hash_next (struct hash_iterator *i)
 {
+  struct hash_slot *slot;
+
   ASSERT (i != NULL);
 
-  i->elem = list_elem_to_hash_elem (list_next (&i->elem->list_elem));
-  while (i->elem == list_elem_to_hash_elem (list_end (i->bucket)))
+  i->elem = NULL;
+  while ((slot = iter_slot (i->hash, i->idx)) != NULL)
     {
-      if (++i->bucket >= i->hash->buckets + i->hash->bucket_cnt)
+      i->idx++;
+      if (slot->elem != NULL && slot->elem != MOVED)
         {
-          i->elem = NULL;
+          i->elem = slot->elem;
           break;
         }
-      i->elem = list_elem_to_hash_elem (list_begin (i->bucket));
     }
   
   return i->elem;
@@ -301,130 +357,176 @@ hash_int (int i)
   return hash_bytes (&i, sizeof i);
 }
 
-/* Returns the bucket in H that E belongs in. */
-static struct list *
-find_bucket (struct hash *h, struct hash_elem *e) 
+/* Returns true if SLOT in H holds an element equal to E, whose
+   hash value is HASH. */
+static bool
+equal (struct hash *h, struct hash_slot *slot, unsigned hash,
+       struct hash_elem *e) 
 {
-  size_t bucket_idx = h->hash (e, h->aux) & (h->bucket_cnt - 1);
-  return &h->buckets[bucket_idx];
+  return (slot->hash == hash && slot->elem != MOVED
+          && !h->less (slot->elem, e, h->aux)
+          && !h->less (e, slot->elem, h->aux));
 }
 
-/* Searches BUCKET in H for a hash element equal to E.  Returns
-   it if found or a null pointer otherwise. */
-static struct hash_elem *
-find_elem (struct hash *h, struct list *bucket, struct hash_elem *e) 
+/* Searches H's current slots for an element equal to E, whose
+   hash value is HASH.  Returns its slot if found or a null
+   pointer otherwise. */
+static struct hash_slot *
+find_slot (struct hash *h, unsigned hash, struct hash_elem *e) 
 {
-  struct list_elem *i;
+  size_t mask = h->slot_cnt - 1;
+  size_t i;
 
-  for (i = list_begin (bucket); i != list_end (bucket); i = list_next (i)) 
-    {
-      struct hash_elem *hi = list_elem_to_hash_elem (i);
-      if (!h->less (hi, e, h->aux) && !h->less (e, hi, h->aux))
-        return hi; 
-    }
+  for (i = hash & mask; h->slots[i].elem != NULL; i = (i + 1) & mask)
+    if (equal (h, &h->slots[i], hash, e))
+      return &h->slots[i];
   return NULL;
 }
 
-/* Returns X with its lowest-order bit set to 1 turned off. */
-static inline size_t
-turn_off_least_1bit (size_t x) 
+/* Searches the slots H is being resized from for an element
+   equal to E, whose hash value is HASH.  Returns its slot if
+   found or a null pointer otherwise. */
+static struct hash_slot *
+find_old_slot (struct hash *h, unsigned hash, struct hash_elem *e) 
 {
-  return x & (x - 1);
-}
+  size_t mask = h->old_cnt - 1;
+  size_t i;
 
-/* Returns true if X is a power of 2, otherwise false. */
-static inline size_t
-is_power_of_2 (size_t x) 
-{
-  return x != 0 && turn_off_least_1bit (x) == 0;
+  if (h->old_slots == NULL)
+    return NULL;
+  for (i = hash & mask; h->old_slots[i].elem != NULL; i = (i + 1) & mask)
+    if (equal (h, &h->old_slots[i], hash, e))
+      return &h->old_slots[i];
+  return NULL;
 }
 
-/* Element per bucket ratios. */
-#define MIN_ELEMS_PER_BUCKET  1 /* Elems/bucket < 1: reduce # of buckets. */
-#define BEST_ELEMS_PER_BUCKET 2 /* Ideal elems/bucket. */
-#define MAX_ELEMS_PER_BUCKET  4 /* Elems/bucket > 4: increase # of buckets. */
-
-/* Changes the number of buckets in hash table H to match the
-   ideal.  This function can fail because of an out-of-memory
-   condition, but that'll just make hash accesses less efficient;
-   we can still continue. */
+/* Puts E, whose hash value is HASH, into the first empty slot of
+   H's current array at or after the one HASH selects.  There
+   must be an empty slot. */
 static void
-rehash (struct hash *h) 
+put_elem (struct hash *h, unsigned hash, struct hash_elem *e) 
 {
-  size_t old_bucket_cnt, new_bucket_cnt;
-  struct list *new_buckets, *old_buckets;
+  size_t mask = h->slot_cnt - 1;
   size_t i;
 
-  ASSERT (h != NULL);
+  ASSERT (h->used_cnt < h->slot_cnt - 1);
 
-  /* Save old bucket info for later use. */
-  old_buckets = h->buckets;
-  old_bucket_cnt = h->bucket_cnt;
-
-  /* Calculate the number of buckets to use now.
-     We want one bucket for about every BEST_ELEMS_PER_BUCKET.
-     We must have at least four buckets, and the number of
-     buckets must be a power of 2. */
-  new_bucket_cnt = h->elem_cnt / BEST_ELEMS_PER_BUCKET;
-  if (new_bucket_cnt < 4)
-    new_bucket_cnt = 4;
-  while (!is_power_of_2 (new_bucket_cnt))
-    new_bucket_cnt = turn_off_least_1bit (new_bucket_cnt);
-
-  /* Don't do anything if the bucket count wouldn't change. */
-  if (new_bucket_cnt == old_bucket_cnt)
-    return;
+  for (i = hash & mask; h->slots[i].elem != NULL; i = (i + 1) & mask)
+    continue;
+  h->slots[i].hash = hash;
+  h->slots[i].elem = e;
+  h->used_cnt++;
+}
 
-  /* Allocate new buckets and initialize them as empty. */
-  new_buckets = malloc (sizeof *new_buckets * new_bucket_cnt);
-  if (new_buckets == NULL) 
+/* Empties SLOT, in H's current array.  Moves later elements in
+   the same run of full slots back into the hole where that keeps
+   them reachable from the slot their hash selects, so that
+   searches can keep stopping at the first empty slot. */
+static void
+remove_slot (struct hash *h, struct hash_slot *slot) 
+{
+  size_t mask = h->slot_cnt - 1;
+  size_t hole = slot - h->slots;
+  size_t i = hole;
+
+  for (;;)
     {
-      /* Allocation failed.  This means that use of the hash table will
-         be less efficient.  However, it is still usable, so
-         there's no reason for it to be an error. */
-      return;
+      size_t home;
+
+      i = (i + 1) & mask;
+      if (h->slots[i].elem == NULL)
+        break;
+
+      /* The element in slot I may move to HOLE unless the slot
+         its hash selects lies cyclically after HOLE, up to I. */
+      home = h->slots[i].hash & mask;
+      if (hole <= i ? hole < home && home <= i : hole < home || home <= i)
+        continue;
+      h->slots[hole] = h->slots[i];
+      hole = i;
     }
-  for (i = 0; i < new_bucket_cnt; i++) 
-    list_init (&new_buckets[i]);
+  h->slots[hole].elem = NULL;
+  h->used_cnt--;
+}
 
-  /* Install new bucket info. */
-  h->buckets = new_buckets;
-  h->bucket_cnt = new_bucket_cnt;
+/* Returns the slot that iteration position IDX in H refers to,
+   or a null pointer past the end.  The old slots come first. */
+static struct hash_slot *
+iter_slot (struct hash *h, size_t idx) 
+{
+  if (idx < h->old_cnt)
+    return &h->old_slots[idx];
+  idx -= h->old_cnt;
+  return idx < h->slot_cnt ? &h->slots[idx] : NULL;
+}
 
-  /* Move each old element into the appropriate new bucket. */
-  for (i = 0; i < old_bucket_cnt; i++) 
+/* Moves the elements of the next CNT old slots of H, if H is
+   being resized, into its current array.  Frees the old array
+   once it is empty. */
+static void
+move_slots (struct hash *h, size_t cnt) 
+{
+  while (h->old_slots != NULL && cnt-- > 0)
     {
-      struct list *old_bucket;
-      struct list_elem *elem, *next;
+      struct hash_slot *slot = &h->old_slots[h->old_idx++];
 
-      old_bucket = &old_buckets[i];
-      for (elem = list_begin (old_bucket);
-           elem != list_end (old_bucket); elem = next) 
+      /* Searches of the old array that start below this slot must
+         still pass over it, so it is marked rather than emptied.
+         Empty slots stay empty, so every search still ends. */
+      if (slot->elem != NULL && slot->elem != MOVED)
         {
-          struct list *new_bucket
-            = find_bucket (h, list_elem_to_hash_elem (elem));
-          next = list_next (elem);
-          list_remove (elem);
-          list_push_front (new_bucket, elem);
+          put_elem (h, slot->hash, slot->elem);
+          slot->elem = MOVED;
         }
-    }
 
-  free (old_buckets);
+      if (h->old_idx >= h->old_cnt)
+        {
+          free (h->old_slots);
+          h->old_slots = NULL;
+          h->old_cnt = h->old_idx = 0;
+        }
+    }
 }
 
-/* Inserts E into BUCKET (in hash table H). */
-static void
-insert_elem (struct hash *h, struct list *bucket, struct hash_elem *e) 
-{
-  h->elem_cnt++;
-  list_push_front (bucket, &e->list_elem);
-}
+/* Starts resizing hash table H if its current array is more than
+   3/4 full, or if it holds fewer than 1/8 as many elements as
+   slots.  Any resize already under way is finished first; it can
+   always finish, since MOVE_SLOTS is large enough that it would
+   otherwise end before the array became 3/4 full.
 
-/* Removes E from hash table H. */
+   This function can fail because of an out-of-memory condition,
+   which just leaves the table fuller or emptier than it should
+   be.  Only if the current array is left with no room for
+   another element is that fatal. */
 static void
-remove_elem (struct hash *h, struct hash_elem *e) 
+resize (struct hash *h) 
 {
-  h->elem_cnt--;
-  list_remove (&e->list_elem);
-}
+  size_t new_slot_cnt;
+  struct hash_slot *new_slots;
+
+  ASSERT (h != NULL);
 
+  if (h->used_cnt * 4 > h->slot_cnt * 3)
+    new_slot_cnt = h->slot_cnt * 2;
+  else if (h->elem_cnt * 8 < h->slot_cnt && h->slot_cnt > MIN_SLOTS)
+    new_slot_cnt = h->slot_cnt / 2;
+  else
+    return;
+
+  move_slots (h, h->old_cnt);
+
+  new_slots = calloc (new_slot_cnt, sizeof *new_slots);
+  if (new_slots == NULL) 
+    {
+      if (h->used_cnt >= h->slot_cnt - 1)
+        PANIC ("hash table full and out of memory to grow it");
+      return;
+    }
+
+  h->old_slots = h->slots;
+  h->old_cnt = h->slot_cnt;
+  h->old_idx = 0;
+  h->slots = new_slots;
+  h->slot_cnt = new_slot_cnt;
+  h->used_cnt = 0;
+}
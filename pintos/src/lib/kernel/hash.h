@@ -6,12 +6,24 @@
    This data structure is thoroughly documented in the Tour of
    Pintos for Project 3.
 
-   This is a standard hash table with chaining.  To locate an
-   element in the table, we compute a hash function over the
-   element's data and use that as an index into an array of
-   doubly linked lists, then linearly search the list.
-
-   The chain lists do not use dynamic allocation.  Instead, each
+   This is a hash table with open addressing.  The table is an
+   array of slots, each holding a pointer to an element and the
+   element's hash value.  To locate an element, we compute a hash
+   function over its data, use that as an index into the array,
+   and check consecutive slots from there ("linear probing") until
+   we find the element or an empty slot.  Comparing the stored
+   hash values first means that the comparison function is rarely
+   called on a non-matching element, and the probes for one
+   lookup usually touch a single cache line.
+
+   When the table gets too full or too empty, it is resized
+   incrementally: a new array is allocated, and every insertion,
+   replacement, and deletion afterward moves a few slots' worth of
+   elements from the old array into it.  Until the old array is
+   empty, lookups check both.  No single operation ever moves the
+   whole table.
+
+   The table does not allocate memory per element.  Instead, each
    structure that can potentially be in a hash must embed a
    struct hash_elem member.  All of the hash functions operate on
    these `struct hash_elem's.  The hash_entry macro allows
@@ -23,12 +35,12 @@
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
-#include "list.h"
 
-/* Hash element. */
+/* Hash element.  The table keeps everything it needs in its own
+   slots, so there is nothing here for it to use. */
 struct hash_elem 
   {
-    struct list_elem list_elem;
+    int unused;
   };
 
 /* Converts pointer to hash element HASH_ELEM into a pointer to
@@ -37,8 +49,8 @@ struct hash_elem
    of the hash element.  See the big comment at the top of the
    file for an example. */
 #define hash_entry(HASH_ELEM, STRUCT, MEMBER)                   \
-        ((STRUCT *) ((uint8_t *) &(HASH_ELEM)->list_elem        \
-                     - offsetof (STRUCT, MEMBER.list_elem)))
+        ((STRUCT *) ((uint8_t *) (HASH_ELEM)                    \
+                     - offsetof (STRUCT, MEMBER)))
 
 /* Computes and returns the hash value for hash element E, given
    auxiliary data AUX. */
@@ -55,12 +67,23 @@ typedef bool hash_less_func (const struct hash_elem *a,
    data AUX. */
 typedef void hash_action_func (struct hash_elem *e, void *aux);
 
+/* A slot in a hash table's array. */
+struct hash_slot
+  {
+    unsigned hash;              /* Hash value of ELEM. */
+    struct hash_elem *elem;     /* Element, or a null pointer if empty. */
+  };
+
 /* Hash table. */
 struct hash 
   {
     size_t elem_cnt;            /* Number of elements in table. */
-    size_t bucket_cnt;          /* Number of buckets, a power of 2. */
-    struct list *buckets;       /* Array of `bucket_cnt' lists. */
+    size_t slot_cnt;            /* Number of slots, a power of 2. */
+    size_t used_cnt;            /* Number of elements in `slots'. */
+    struct hash_slot *slots;    /* Array of `slot_cnt' slots. */
+    size_t old_cnt;             /* Slots in `old_slots', 0 if not resizing. */
+    size_t old_idx;             /* Old slots below this have been moved. */
+    struct hash_slot *old_slots; /* Slots being moved into `slots'. */
     hash_hash_func *hash;       /* Hash function. */
     hash_less_func *less;       /* Comparison function. */
     void *aux;                  /* Auxiliary data for `hash' and `less'. */
@@ -70,8 +93,8 @@ struct hash
 struct hash_iterator 
   {
     struct hash *hash;          /* The hash table. */
-    struct list *bucket;        /* Current bucket. */
-    struct hash_elem *elem;     /* Current hash element in current bucket. */
+    size_t idx;                 /* Next slot, counting old slots first. */
+    struct hash_elem *elem;     /* Current hash element. */
   };
 
 /* Basic life cycle. */
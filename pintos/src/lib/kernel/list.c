@@ -293,7 +293,8 @@ list_back (struct list *list)
 }
 
 /* Returns the number of elements in LIST.
-   Runs in O(n) in the number of elements. */
+   Runs in O(n) in the number of elements; see sized_list_size()
+   for a constant-time alternative. */
 size_t
 list_size (struct list *list)
 {
@@ -349,92 +350,101 @@ is_sorted (struct list_elem *a, struct list_elem *b,
   return true;
 }
 
-/* Finds a run, starting at A and ending not after B, of list
-   elements that are in nondecreasing order according to LESS
-   given auxiliary data AUX.  Returns the (exclusive) end of the
-   run.
-   A through B (exclusive) must form a non-empty range. */
+/* Merges A and B, two null-terminated chains of elements linked
+   through their `next' members, each sorted in nondecreasing
+   order according to LESS given auxiliary data AUX, and returns
+   the merged chain.  Elements of A come before equal elements of
+   B.  `prev' members are left for the caller to fix. */
 static struct list_elem *
-find_end_of_run (struct list_elem *a, struct list_elem *b,
-                 list_less_func *less, void *aux)
+merge_chains (struct list_elem *a, struct list_elem *b,
+              list_less_func *less, void *aux)
 {
-  ASSERT (a != NULL);
-  ASSERT (b != NULL);
-  ASSERT (less != NULL);
-  ASSERT (a != b);
-  
-  do 
-    {
-      a = list_next (a);
-    }
-  while (a != b && !less (a, list_prev (a), aux));
-  return a;
-}
+  struct list_elem head;
+  struct list_elem *tail = &head;
 
-/* Merges A0 through A1B0 (exclusive) with A1B0 through B1
-   (exclusive) to form a combined range also ending at B1
-   (exclusive).  Both input ranges must be nonempty and sorted in
-   nondecreasing order according to LESS given auxiliary data
-   AUX.  The output range will be sorted the same way. */
-static void
-inplace_merge (struct list_elem *a0, struct list_elem *a1b0,
-               struct list_elem *b1,
-               list_less_func *less, void *aux)
-{
-  ASSERT (a0 != NULL);
-  ASSERT (a1b0 != NULL);
-  ASSERT (b1 != NULL);
-  ASSERT (less != NULL);
-  ASSERT (is_sorted (a0, a1b0, less, aux));
-  ASSERT (is_sorted (a1b0, b1, less, aux));
-
-  while (a0 != a1b0 && a1b0 != b1)
-    if (!less (a1b0, a0, aux)) 
-      a0 = list_next (a0);
-    else 
+  while (a != NULL && b != NULL)
+    if (less (b, a, aux))
       {
-        a1b0 = list_next (a1b0);
-        list_splice (a0, list_prev (a1b0), a1b0);
+        tail->next = b;
+        tail = b;
+        b = b->next;
       }
+    else
+      {
+        tail->next = a;
+        tail = a;
+        a = a->next;
+      }
+  tail->next = a != NULL ? a : b;
+  return head.next;
 }
 
+/* Number of chains list_sort() can keep pending.  Chain I holds
+   2**I elements, so this is enough for any list that fits in
+   memory. */
+#define SORT_BINS 32
+
 /* Sorts LIST according to LESS given auxiliary data AUX, using a
-   natural iterative merge sort that runs in O(n lg n) time and
-   O(1) space in the number of elements in LIST. */
+   bottom-up merge sort that runs in O(n lg n) time and O(1) space
+   in the number of elements in LIST, whatever their initial
+   order.  The sort is stable.
+
+   The elements are taken off the list one at a time and merged
+   into a set of sorted chains of 1, 2, 4, ... elements, the way
+   a binary counter carries, so that every merge combines two
+   chains of the same length.  Chains are linked through `next'
+   only; `prev' pointers are rebuilt at the end. */
 void
 list_sort (struct list *list, list_less_func *less, void *aux)
 {
-  size_t output_run_cnt;        /* Number of runs output in current pass. */
+  struct list_elem *bins[SORT_BINS];
+  struct list_elem *e, *next, *prev;
+  size_t i, bin_cnt = 0;
 
   ASSERT (list != NULL);
   ASSERT (less != NULL);
 
-  /* Pass over the list repeatedly, merging adjacent runs of
-     nondecreasing elements, until only one run is left. */
-  do
+  if (list_empty (list) || list_begin (list) == list_rbegin (list))
+    return;
+
+  list_rbegin (list)->next = NULL;
+  for (e = list_begin (list); e != NULL; e = next)
     {
-      struct list_elem *a0;     /* Start of first run. */
-      struct list_elem *a1b0;   /* End of first run, start of second. */
-      struct list_elem *b1;     /* End of second run. */
+      struct list_elem *chain = e;
+
+      next = e->next;
+      e->next = NULL;
 
-      output_run_cnt = 0;
-      for (a0 = list_begin (list); a0 != list_end (list); a0 = b1)
+      /* Bins hold chains of earlier elements, so they go first. */
+      for (i = 0; i < bin_cnt && bins[i] != NULL; i++)
+        {
+          chain = merge_chains (bins[i], chain, less, aux);
+          bins[i] = NULL;
+        }
+      if (i == bin_cnt)
         {
-          /* Each iteration produces one output run. */
-          output_run_cnt++;
-
-          /* Locate two adjacent runs of nondecreasing elements
-             A0...A1B0 and A1B0...B1. */
-          a1b0 = find_end_of_run (a0, list_end (list), less, aux);
-          if (a1b0 == list_end (list))
-            break;
-          b1 = find_end_of_run (a1b0, list_end (list), less, aux);
-
-          /* Merge the runs. */
-          inplace_merge (a0, a1b0, b1, less, aux);
+          ASSERT (bin_cnt < SORT_BINS);
+          bin_cnt++;
         }
+      bins[i] = chain;
     }
-  while (output_run_cnt > 1);
+
+  /* Merge what is left, smallest (latest) chain first. */
+  e = NULL;
+  for (i = 0; i < bin_cnt; i++)
+    if (bins[i] != NULL)
+      e = merge_chains (bins[i], e, less, aux);
+
+  /* Put the sorted chain back in LIST. */
+  prev = list_head (list);
+  for (; e != NULL; e = e->next)
+    {
+      prev->next = e;
+      e->prev = prev;
+      prev = e;
+    }
+  prev->next = list_tail (list);
+  list_tail (list)->prev = prev;
 
   ASSERT (is_sorted (list_begin (list), list_end (list), less, aux));
 }
@@ -458,6 +468,43 @@ list_insert_ordered (struct list *list, struct list_elem *elem,
   return list_insert (e, elem);
 }
 
+/* Inserts ELEM in the proper position in LIST, which must be
+   sorted according to LESS given auxiliary data AUX, starting
+   the search at HINT, an element of LIST or its tail.  ELEM goes
+   in the same place list_insert_ordered() would put it, but the
+   time taken is proportional to its distance from HINT rather
+   than from the front, so a caller that inserts near the same
+   spot over and over, such as after the element it inserted
+   last, can avoid walking a long list each time. */
+void
+list_insert_ordered_hint (struct list *list, struct list_elem *elem,
+                          struct list_elem *hint,
+                          list_less_func *less, void *aux)
+{
+  struct list_elem *e;
+
+  ASSERT (list != NULL);
+  ASSERT (elem != NULL);
+  ASSERT (hint != NULL && hint != list_head (list));
+  ASSERT (less != NULL);
+
+  /* ELEM belongs before the first element it is less than.  The
+     tail counts as greater than every element. */
+  e = hint;
+  if (e == list_end (list) || less (elem, e, aux))
+    {
+      while (list_prev (e) != list_head (list) && less (elem, list_prev (e), aux))
+        e = list_prev (e);
+    }
+  else
+    {
+      do
+        e = list_next (e);
+      while (e != list_end (list) && !less (elem, e, aux));
+    }
+  list_insert (e, elem);
+}
+
 /* Iterates through LIST and removes all but the first in each
    set of adjacent elements that are equal according to LESS
    given auxiliary data AUX.  If DUPLICATES is non-null, then the
@@ -522,3 +569,75 @@ list_min (struct list *list, list_less_func *less, void *aux)
     }
   return min;
 }
+
+/* Initializes SL as an empty sized list. */
+void
+sized_list_init (struct sized_list *sl)
+{
+  ASSERT (sl != NULL);
+  list_init (&sl->list);
+  sl->size = 0;
+}
+
+/* Inserts ELEM just before BEFORE, which must be an interior
+   element or the tail of SL. */
+void
+sized_list_insert (struct sized_list *sl, struct list_elem *before,
+                   struct list_elem *elem)
+{
+  list_insert (before, elem);
+  sl->size++;
+}
+
+/* Inserts ELEM at the beginning of SL. */
+void
+sized_list_push_front (struct sized_list *sl, struct list_elem *elem)
+{
+  list_push_front (&sl->list, elem);
+  sl->size++;
+}
+
+/* Inserts ELEM at the end of SL. */
+void
+sized_list_push_back (struct sized_list *sl, struct list_elem *elem)
+{
+  list_push_back (&sl->list, elem);
+  sl->size++;
+}
+
+/* Removes ELEM, which must be in SL, and returns the element
+   that followed it, as list_remove() does. */
+struct list_elem *
+sized_list_remove (struct sized_list *sl, struct list_elem *elem)
+{
+  ASSERT (sl->size > 0);
+  sl->size--;
+  return list_remove (elem);
+}
+
+/* Removes the front element from SL and returns it.
+   Undefined behavior if SL is empty before removal. */
+struct list_elem *
+sized_list_pop_front (struct sized_list *sl)
+{
+  ASSERT (sl->size > 0);
+  sl->size--;
+  return list_pop_front (&sl->list);
+}
+
+/* Removes the back element from SL and returns it.
+   Undefined behavior if SL is empty before removal. */
+struct list_elem *
+sized_list_pop_back (struct sized_list *sl)
+{
+  ASSERT (sl->size > 0);
+  sl->size--;
+  return list_pop_back (&sl->list);
+}
+
+/* Returns the number of elements in SL, in constant time. */
+size_t
+sized_list_size (const struct sized_list *sl)
+{
+  return sl->size;
+}
@@ -171,6 +171,9 @@ void list_sort (struct list *,
                 list_less_func *, void *aux);
 void list_insert_ordered (struct list *, struct list_elem *,
                           list_less_func *, void *aux);
+void list_insert_ordered_hint (struct list *, struct list_elem *,
+                               struct list_elem *hint,
+                               list_less_func *, void *aux);
 void list_unique (struct list *, struct list *duplicates,
                   list_less_func *, void *aux);
 
@@ -178,4 +181,31 @@ void list_unique (struct list *, struct list *duplicates,
 struct list_elem *list_max (struct list *, list_less_func *, void *aux);
 struct list_elem *list_min (struct list *, list_less_func *, void *aux);
 
+/* List that keeps count of its elements.
+
+   list_size() walks the whole list.  A list whose size is wanted
+   often can be a sized_list instead, which answers in constant
+   time as long as every insertion and removal goes through the
+   sized_list functions below.  Traversal and the other read-only
+   operations use the ordinary list functions on its LIST member:
+
+       for (e = list_begin (&sl.list); e != list_end (&sl.list);
+            e = list_next (e))
+         ... */
+struct sized_list
+  {
+    struct list list;           /* Elements. */
+    size_t size;                /* Number of elements in LIST. */
+  };
+
+void sized_list_init (struct sized_list *);
+void sized_list_insert (struct sized_list *, struct list_elem *before,
+                        struct list_elem *);
+void sized_list_push_front (struct sized_list *, struct list_elem *);
+void sized_list_push_back (struct sized_list *, struct list_elem *);
+struct list_elem *sized_list_remove (struct sized_list *, struct list_elem *);
+struct list_elem *sized_list_pop_front (struct sized_list *);
+struct list_elem *sized_list_pop_back (struct sized_list *);
+size_t sized_list_size (const struct sized_list *);
+
 #endif /* lib/kernel/list.h */
@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <ctype.h>
 #include <inttypes.h>
+#include <limits.h>
 #include <round.h>
 #include <stdint.h>
 #include <string.h>
@@ -176,8 +177,18 @@ __vprintf (const char *format, va_list args,
           continue;
         }
 
-      /* Parse conversion specifiers. */
-      format = parse_conversion (format, &c, &args);
+      /* Parse conversion specifiers.  A bare conversion such as
+         %d or %s, by far the most common kind, needs no parsing. */
+      if (*format == 'd' || *format == 's' || *format == 'u'
+          || *format == 'x')
+        {
+          c.flags = 0;
+          c.width = 0;
+          c.precision = -1;
+          c.type = INT;
+        }
+      else
+        format = parse_conversion (format, &c, &args);
 
       /* Do conversion. */
       switch (*format) 
@@ -505,10 +516,25 @@ format_integer (uintmax_t value, bool is_signed, bool negative,
   digit_cnt = 0;
   while (value > 0) 
     {
+      int digit;
+
       if ((c->flags & GROUP) && digit_cnt > 0 && digit_cnt % b->group == 0)
         *cp++ = ',';
-      *cp++ = b->digits[value % b->base];
-      value /= b->base;
+
+      /* Dividing a uintmax_t calls into libgcc on 32-bit
+         machines, so use native arithmetic once VALUE fits. */
+      if (value <= ULONG_MAX)
+        {
+          unsigned long v = value;
+          digit = v % b->base;
+          value = v / b->base;
+        }
+      else
+        {
+          digit = value % b->base;
+          value /= b->base;
+        }
+      *cp++ = b->digits[digit];
       digit_cnt++;
     }
 
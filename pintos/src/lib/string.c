@@ -1,5 +1,52 @@
 #include <string.h>
 #include <debug.h>
+#include <stdint.h>
+
+/* The block functions below move a word at a time once the
+   destination is word-aligned, using the x86 string instructions
+   (rep movsl, rep stosl), and handle the unaligned head and tail
+   a byte at a time.  Blocks shorter than WORD_MIN bytes aren't
+   worth the setup and are done a byte at a time throughout.
+   Interrupt entry clears the direction flag, so the string
+   instructions always run upward unless we set it ourselves. */
+#define WORD_MIN 16
+
+/* A word that may alias any other type, for memcmp(). */
+typedef uint32_t word_t __attribute__ ((__may_alias__));
+
+/* Copies CNT words from SRC to DST, upward. */
+static inline void
+copy_words_up (void *dst, const void *src, size_t cnt) 
+{
+  asm volatile ("rep movsl"
+                : "+D" (dst), "+S" (src), "+c" (cnt) : : "memory");
+}
+
+/* Copies CNT words from SRC to DST, downward, where DST and SRC
+   point to the last word of each block. */
+static inline void
+copy_words_down (void *dst, const void *src, size_t cnt) 
+{
+  asm volatile ("std; rep movsl; cld"
+                : "+D" (dst), "+S" (src), "+c" (cnt) : : "memory");
+}
+
+/* Stores CNT copies of WORD at DST. */
+static inline void
+store_words (void *dst, uint32_t word, size_t cnt) 
+{
+  asm volatile ("rep stosl"
+                : "+D" (dst), "+c" (cnt) : "a" (word) : "memory");
+}
+
+/* Returns the number of bytes from P up to the next word
+   boundary, at most SIZE. */
+static inline size_t
+head_size (const void *p, size_t size) 
+{
+  size_t head = -(uintptr_t) p % sizeof (word_t);
+  return head < size ? head : size;
+}
 
 /* Copies SIZE bytes from SRC to DST, which must not overlap.
    Returns DST. */
@@ -12,6 +59,21 @@ memcpy (void *dst_, const void *src_, size_t size)
   ASSERT (dst != NULL || size == 0);
   ASSERT (src != NULL || size == 0);
 
+  if (size >= WORD_MIN) 
+    {
+      size_t head = head_size (dst, size);
+      size_t words;
+
+      size -= head;
+      while (head-- > 0)
+        *dst++ = *src++;
+
+      words = size / sizeof (word_t);
+      copy_words_up (dst, src, words);
+      dst += words * sizeof (word_t);
+      src += words * sizeof (word_t);
+      size %= sizeof (word_t);
+    }
   while (size-- > 0)
     *dst++ = *src++;
 
@@ -29,20 +91,32 @@ memmove (void *dst_, const void *src_, size_t size)
   ASSERT (dst != NULL || size == 0);
   ASSERT (src != NULL || size == 0);
 
-  if (dst < src) 
-    {
-      while (size-- > 0)
-        *dst++ = *src++;
-    }
-  else 
+  if (dst < src || dst >= src + size) 
+    return memcpy (dst_, src_, size);
+
+  /* DST overlaps the end of SRC: copy from the end backward. */
+  dst += size;
+  src += size;
+  if (size >= WORD_MIN) 
     {
-      dst += size;
-      src += size;
-      while (size-- > 0)
+      size_t tail = (uintptr_t) dst % sizeof (word_t);
+      size_t words;
+
+      size -= tail;
+      while (tail-- > 0)
         *--dst = *--src;
+
+      words = size / sizeof (word_t);
+      if (words > 0)
+        copy_words_down (dst - sizeof (word_t), src - sizeof (word_t), words);
+      dst -= words * sizeof (word_t);
+      src -= words * sizeof (word_t);
+      size %= sizeof (word_t);
     }
+  while (size-- > 0)
+    *--dst = *--src;
 
-  return dst;
+  return dst_;
 }
 
 /* Find the first differing byte in the two blocks of SIZE bytes
@@ -58,6 +132,23 @@ memcmp (const void *a_, const void *b_, size_t size)
   ASSERT (a != NULL || size == 0);
   ASSERT (b != NULL || size == 0);
 
+  if (size >= WORD_MIN) 
+    {
+      size_t head = head_size (a, size);
+
+      /* Compare the head bytes, then whole words until two
+         differ; the byte loop below finds the byte that does. */
+      for (; head > 0; head--, size--, a++, b++)
+        if (*a != *b)
+          return *a > *b ? +1 : -1;
+      for (; size >= sizeof (word_t); size -= sizeof (word_t))
+        {
+          if (*(const word_t *) a != *(const word_t *) b)
+            break;
+          a += sizeof (word_t);
+          b += sizeof (word_t);
+        }
+    }
   for (; size-- > 0; a++, b++)
     if (*a != *b)
       return *a > *b ? +1 : -1;
@@ -282,6 +373,20 @@ memset (void *dst_, int value, size_t size)
 
   ASSERT (dst != NULL || size == 0);
   
+  if (size >= WORD_MIN) 
+    {
+      size_t head = head_size (dst, size);
+      size_t words;
+
+      size -= head;
+      while (head-- > 0)
+        *dst++ = value;
+
+      words = size / sizeof (word_t);
+      store_words (dst, (unsigned char) value * 0x01010101u, words);
+      dst += words * sizeof (word_t);
+      size %= sizeof (word_t);
+    }
   while (size-- > 0)
     *dst++ = value;
 
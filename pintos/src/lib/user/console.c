@@ -1,5 +1,4 @@
 #include <stdio.h>
-#include <string.h>
 #include <syscall.h>
 #include <syscall-nr.h>
 
@@ -26,13 +25,11 @@ hprintf (int handle, const char *format, ...)
 }
 
 /* Writes string S to the console, followed by a new-line
-   character. */
+   character, with a single write when S fits in the buffer. */
 int
 puts (const char *s) 
 {
-  write (STDOUT_FILENO, s, strlen (s));
-  putchar ('\n');
-
+  hprintf (STDOUT_FILENO, "%s\n", s);
   return 0;
 }
 
@@ -48,7 +45,7 @@ putchar (int c)
 /* Auxiliary data for vhprintf_helper(). */
 struct vhprintf_aux 
   {
-    char buf[64];       /* Character buffer. */
+    char buf[256];      /* Character buffer. */
     char *p;            /* Current position in buffer. */
     int char_cnt;       /* Total characters written so far. */
     int handle;         /* Output file handle. */
@@ -59,7 +56,8 @@ static void flush (struct vhprintf_aux *);
 
 /* Formats the printf() format specification FORMAT with
    arguments given in ARGS and writes the output to the given
-   HANDLE. */
+   HANDLE.  The output is buffered, so a line of output takes a
+   single write system call. */
 int
 vhprintf (int handle, const char *format, va_list args) 
 {
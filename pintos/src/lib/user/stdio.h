@@ -4,4 +4,26 @@
 int hprintf (int, const char *, ...) PRINTF_FORMAT (2, 3);
 int vhprintf (int, const char *, va_list) PRINTF_FORMAT (2, 0);
 
+/* Buffered file streams. */
+typedef struct stream FILE;
+
+#define BUFSIZ 4096             /* Default stream buffer size. */
+#define FOPEN_MAX 8             /* Maximum number of open streams. */
+#define EOF (-1)
+
+FILE *fopen (const char *file, const char *mode);
+FILE *fdopen (int fd, const char *mode);
+void setbuffer (FILE *, char *buf, size_t size);
+size_t fread (void *, size_t size, size_t cnt, FILE *);
+size_t fwrite (const void *, size_t size, size_t cnt, FILE *);
+int fgetc (FILE *);
+int fputc (int, FILE *);
+char *fgets (char *, int size, FILE *);
+int fputs (const char *, FILE *);
+int fflush (FILE *);
+int fclose (FILE *);
+int feof (FILE *);
+int ferror (FILE *);
+int fileno (FILE *);
+
 #endif /* lib/user/stdio.h */
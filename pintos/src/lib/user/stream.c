@@ -0,0 +1,422 @@
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+
+/* Buffered file streams.
+
+   A stream wraps a file descriptor with a buffer, so that a
+   program reading or writing a few bytes at a time makes one
+   system call per buffer rather than one per call.  A stream is
+   either reading, in which case the buffer holds bytes read ahead
+   from the file, or writing, in which case it holds bytes not yet
+   written.  Switching from one to the other flushes pending
+   output or gives back read-ahead by seeking.
+
+   There is no malloc() in user programs, so streams come from a
+   fixed table of FOPEN_MAX, each with a BUFSIZ default buffer.
+   Output is not flushed when a program exits: call fclose() or
+   fflush() first.
+
+   Files in this file system cannot grow, so a stream can only
+   write within its file's existing size, and a write past the
+   end fails.  Create a file at the size it will need first. */
+
+/* What the buffer holds. */
+enum stream_state
+  {
+    IDLE,                       /* Nothing. */
+    READING,                    /* Bytes read ahead, from POS to END. */
+    WRITING                     /* Pending output, from BUF to POS. */
+  };
+
+/* A stream. */
+struct stream
+  {
+    int fd;                     /* File descriptor. */
+    char *buf;                  /* Buffer, or a null pointer if free. */
+    size_t size;                /* Size of BUF. */
+    char *pos;                  /* Current position in BUF. */
+    char *end;                  /* End of read-ahead in BUF. */
+    enum stream_state state;    /* What BUF holds. */
+    bool eof;                   /* Reached end of file. */
+    bool error;                 /* A read or write failed. */
+    char ch;                    /* Buffer for an unbuffered stream. */
+  };
+
+static struct stream streams[FOPEN_MAX];
+static char buffers[FOPEN_MAX][BUFSIZ];
+
+static bool fill (struct stream *);
+static bool start_reading (struct stream *);
+static bool start_writing (struct stream *);
+static bool write_all (struct stream *, const char *, size_t);
+
+/* Opens FILE, which must already exist, and returns a stream for
+   it, or a null pointer if FILE cannot be opened or all streams
+   are in use.  MODE is "r" to read from the start of the file or
+   "w" to write from the start.  Files can neither grow nor be
+   truncated, so "w" overwrites an existing file in place, and
+   neither creating a file nor appending ("a") is supported.  A
+   trailing "+" is accepted and ignored, because every Pintos
+   file descriptor can both read and write. */
+FILE *
+fopen (const char *file, const char *mode)
+{
+  FILE *s;
+  int fd;
+
+  if (mode[0] != 'r' && mode[0] != 'w')
+    return NULL;
+
+  fd = open (file);
+  if (fd < 0)
+    return NULL;
+
+  s = fdopen (fd, mode);
+  if (s == NULL)
+    {
+      close (fd);
+      return NULL;
+    }
+  return s;
+}
+
+/* Returns a stream for the open file descriptor FD, or a null
+   pointer if all streams are in use.  MODE is ignored. */
+FILE *
+fdopen (int fd, const char *mode UNUSED)
+{
+  FILE *s;
+
+  for (s = streams; s < streams + FOPEN_MAX; s++)
+    if (s->buf == NULL)
+      {
+        s->fd = fd;
+        s->buf = buffers[s - streams];
+        s->size = BUFSIZ;
+        s->pos = s->end = s->buf;
+        s->state = IDLE;
+        s->eof = s->error = false;
+        return s;
+      }
+  return NULL;
+}
+
+/* Makes S use the SIZE bytes at BUF as its buffer, or makes it
+   unbuffered if BUF is a null pointer, so that every call is
+   passed straight through to read() or write().  Must be called
+   before the first read or write on S. */
+void
+setbuffer (FILE *s, char *buf, size_t size)
+{
+  ASSERT (s->state == IDLE);
+
+  if (buf != NULL && size > 0)
+    {
+      s->buf = buf;
+      s->size = size;
+    }
+  else
+    {
+      s->buf = &s->ch;
+      s->size = 1;
+    }
+  s->pos = s->end = s->buf;
+}
+
+/* Reads up to CNT objects of SIZE bytes each from S into BUFFER.
+   Returns the number of whole objects read, which is less than
+   CNT only at end of file or on error. */
+size_t
+fread (void *buffer, size_t size, size_t cnt, FILE *s)
+{
+  char *dst = buffer;
+  size_t left = size * cnt;
+
+  if (left == 0 || !start_reading (s))
+    return 0;
+
+  while (left > 0)
+    {
+      size_t n = s->end - s->pos;
+
+      if (n > 0)
+        {
+          /* Copy out what the buffer has. */
+          if (n > left)
+            n = left;
+          memcpy (dst, s->pos, n);
+          s->pos += n;
+        }
+      else if (left >= s->size)
+        {
+          /* Read a request at least as big as the buffer
+             directly, instead of copying it through the buffer. */
+          int retval = read (s->fd, dst, left);
+          if (retval <= 0)
+            {
+              s->eof = retval == 0;
+              s->error = retval < 0;
+              break;
+            }
+          n = retval;
+        }
+      else if (!fill (s))
+        break;
+      dst += n;
+      left -= n;
+    }
+  return (size * cnt - left) / size;
+}
+
+/* Writes CNT objects of SIZE bytes each from BUFFER to S.
+   Returns the number of whole objects written, which is less
+   than CNT only on error. */
+size_t
+fwrite (const void *buffer, size_t size, size_t cnt, FILE *s)
+{
+  const char *src = buffer;
+  size_t total = size * cnt;
+  size_t room;
+
+  if (total == 0 || !start_writing (s))
+    return 0;
+
+  room = s->buf + s->size - s->pos;
+  if (total < room)
+    {
+      /* It fits: just add it to the buffer. */
+      memcpy (s->pos, src, total);
+      s->pos += total;
+      return cnt;
+    }
+
+  /* Fill up and flush the buffer, if it has anything in it, then
+     write as many whole buffers as possible directly and keep the
+     rest. */
+  if (s->pos > s->buf)
+    {
+      memcpy (s->pos, src, room);
+      s->pos += room;
+      if (fflush (s) != 0)
+        return 0;
+      src += room;
+      total -= room;
+    }
+  if (total >= s->size)
+    {
+      size_t direct = total - total % s->size;
+      if (!write_all (s, src, direct))
+        return (size * cnt - total) / size;
+      src += direct;
+      total -= direct;
+    }
+  start_writing (s);
+  memcpy (s->pos, src, total);
+  s->pos += total;
+  return cnt;
+}
+
+/* Reads and returns one byte from S, or EOF at end of file or on
+   error. */
+int
+fgetc (FILE *s)
+{
+  if (s->state == READING && s->pos < s->end)
+    return (unsigned char) *s->pos++;
+  if (!start_reading (s) || !fill (s))
+    return EOF;
+  return (unsigned char) *s->pos++;
+}
+
+/* Writes C to S.  Returns C, or EOF on error. */
+int
+fputc (int c, FILE *s)
+{
+  if (s->state != WRITING && !start_writing (s))
+    return EOF;
+  *s->pos++ = c;
+  if (s->pos >= s->buf + s->size && fflush (s) != 0)
+    return EOF;
+  return (unsigned char) c;
+}
+
+/* Reads a line from S into the SIZE bytes at LINE: stops after
+   a new-line, which is kept, at end of file, or when SIZE - 1
+   bytes have been read, and null-terminates the result.  Returns
+   LINE, or a null pointer if end of file or an error comes
+   before any byte is read. */
+char *
+fgets (char *line, int size, FILE *s)
+{
+  char *dst = line;
+  size_t left;
+
+  if (size <= 0 || !start_reading (s))
+    return NULL;
+
+  left = size - 1;
+  while (left > 0)
+    {
+      char *nl;
+      size_t n;
+
+      if (s->pos >= s->end && !fill (s))
+        break;
+
+      /* Copy up to and including the first new-line. */
+      n = s->end - s->pos;
+      if (n > left)
+        n = left;
+      nl = memchr (s->pos, '\n', n);
+      if (nl != NULL)
+        n = nl - s->pos + 1;
+      memcpy (dst, s->pos, n);
+      s->pos += n;
+      dst += n;
+      left -= n;
+      if (nl != NULL)
+        break;
+    }
+
+  if (dst == line)
+    return NULL;
+  *dst = '\0';
+  return line;
+}
+
+/* Writes STRING to S, without a new-line.  Returns 0 if
+   successful, EOF on error. */
+int
+fputs (const char *string, FILE *s)
+{
+  size_t length = strlen (string);
+  return fwrite (string, 1, length, s) == length ? 0 : EOF;
+}
+
+/* Writes any output pending in S to its file.  For a stream that
+   is reading, drops the read-ahead and seeks the file back to the
+   stream's position.  Returns 0 if successful, EOF on error. */
+int
+fflush (FILE *s)
+{
+  if (s->state == WRITING)
+    {
+      size_t n = s->pos - s->buf;
+      s->pos = s->buf;
+      if (!write_all (s, s->buf, n))
+        return EOF;
+    }
+  else if (s->state == READING && s->pos < s->end)
+    {
+      /* The console cannot seek. */
+      if (s->fd > STDOUT_FILENO)
+        seek (s->fd, tell (s->fd) - (s->end - s->pos));
+    }
+  s->pos = s->end = s->buf;
+  s->state = IDLE;
+  return 0;
+}
+
+/* Flushes S, closes its file descriptor unless it is the
+   console, and frees S.  Returns 0 if successful, EOF if the
+   flush failed. */
+int
+fclose (FILE *s)
+{
+  int retval = fflush (s);
+  if (s->fd > STDOUT_FILENO)
+    close (s->fd);
+  s->buf = NULL;
+  return retval;
+}
+
+/* Returns true if a read from S has reached end of file. */
+int
+feof (FILE *s)
+{
+  return s->eof;
+}
+
+/* Returns true if a read or write on S has failed. */
+int
+ferror (FILE *s)
+{
+  return s->error;
+}
+
+/* Returns the file descriptor underlying S. */
+int
+fileno (FILE *s)
+{
+  return s->fd;
+}
+
+/* Refills the buffer of S, which must be reading and have no
+   read-ahead left.  Returns true if at least one byte was read,
+   false at end of file or on error. */
+static bool
+fill (struct stream *s)
+{
+  int retval = read (s->fd, s->buf, s->size);
+
+  s->pos = s->buf;
+  if (retval <= 0)
+    {
+      s->end = s->buf;
+      s->eof = retval == 0;
+      s->error = retval < 0;
+      return false;
+    }
+  s->end = s->buf + retval;
+  return true;
+}
+
+/* Gets S ready to read, flushing any pending output.  Returns
+   false if the flush failed. */
+static bool
+start_reading (struct stream *s)
+{
+  if (s->state != READING)
+    {
+      if (fflush (s) != 0)
+        return false;
+      s->state = READING;
+    }
+  return true;
+}
+
+/* Gets S ready to write, dropping any read-ahead.  Returns false
+   if that failed. */
+static bool
+start_writing (struct stream *s)
+{
+  if (s->state != WRITING)
+    {
+      if (fflush (s) != 0)
+        return false;
+      s->state = WRITING;
+      s->eof = false;
+    }
+  return true;
+}
+
+/* Writes the SIZE bytes in BUFFER to the file underlying S,
+   retrying short writes.  Returns true if successful, false and
+   marks S as in error if a write fails to make progress. */
+static bool
+write_all (struct stream *s, const char *buffer, size_t size)
+{
+  while (size > 0)
+    {
+      int retval = write (s->fd, buffer, size);
+      if (retval <= 0)
+        {
+          s->error = true;
+          return false;
+        }
+      buffer += retval;
+      size -= retval;
+    }
+  return true;
+}
@@ -0,0 +1,335 @@
+/* Test program for lib/kernel/hash.c.
+
+   Grows a hash table one element at a time and shrinks it again,
+   then runs random insertions, replacements, deletions and
+   lookups, checking the table against an array after every
+   step.  Everything is done twice: once with a good hash
+   function, and once with one that sends every element to one of
+   a few slots, so that elements collide and probe sequences run
+   long.  Resizes are incremental, so many of the operations land
+   while the table is moving from one array to another; the test
+   checks that each kind of operation was tried in that state.
+
+   This is not a test we will run on your submitted projects.
+   It is here for completeness.
+*/
+
+#undef NDEBUG
+#include <debug.h>
+#include <hash.h>
+#include <random.h>
+#include <stdio.h>
+#include "threads/test.h"
+
+/* Number of distinct values that we will put in a table. */
+#define MAX_SIZE 128
+
+/* Number of random operations per hash function. */
+#define RANDOM_OPS 4096
+
+/* A hash table element. */
+struct value
+  {
+    struct hash_elem elem;      /* Hash element. */
+    int value;                  /* Item value. */
+  };
+
+/* Two elements for each value, so that hash_replace() has
+   something to replace an element with. */
+static struct value values[2][MAX_SIZE];
+
+/* The element for each value that is in the table, or a null
+   pointer if the value is not in the table. */
+static struct value *in_table[MAX_SIZE];
+
+/* Number of values in the table. */
+static size_t in_cnt;
+
+/* Operations of each kind done while a resize was under way. */
+static int resizing_inserts, resizing_replaces;
+static int resizing_deletes, resizing_finds;
+
+static void test_hash (hash_hash_func *, const char *name);
+static void do_insert (struct hash *, int value);
+static void do_replace (struct hash *, int value);
+static void do_delete (struct hash *, int value);
+static void do_find (struct hash *, int value);
+static void verify_hash (struct hash *);
+static void shuffle (int[], size_t);
+static unsigned value_hash (const struct hash_elem *, void *);
+static unsigned colliding_hash (const struct hash_elem *, void *);
+static bool value_less (const struct hash_elem *, const struct hash_elem *,
+                        void *);
+
+/* Test the hash table implementation. */
+void
+test (void)
+{
+  test_hash (value_hash, "good hash");
+  test_hash (colliding_hash, "colliding hash");
+  printf ("hash: PASS\n");
+}
+
+/* Runs all the tests on a table that uses HASH, described by
+   NAME. */
+static void
+test_hash (hash_hash_func *hash, const char *name)
+{
+  struct hash h;
+  size_t max_slot_cnt;
+  int order[MAX_SIZE];
+  int i;
+
+  printf ("testing hash table with %s:", name);
+  for (i = 0; i < MAX_SIZE; i++)
+    {
+      values[0][i].value = values[1][i].value = i;
+      in_table[i] = NULL;
+      order[i] = i;
+    }
+  in_cnt = 0;
+  resizing_inserts = resizing_replaces = 0;
+  resizing_deletes = resizing_finds = 0;
+  ASSERT (hash_init (&h, hash, value_less, NULL));
+  verify_hash (&h);
+
+  /* Grow the table, trying to insert each value twice. */
+  printf (" grow");
+  shuffle (order, MAX_SIZE);
+  for (i = 0; i < MAX_SIZE; i++)
+    {
+      do_insert (&h, order[i]);
+      do_insert (&h, order[i]);
+      verify_hash (&h);
+    }
+  ASSERT (h.slot_cnt >= MAX_SIZE);
+  max_slot_cnt = h.slot_cnt;
+
+  /* Replace every value, in a different order. */
+  printf (" replace");
+  shuffle (order, MAX_SIZE);
+  for (i = 0; i < MAX_SIZE; i++)
+    {
+      do_replace (&h, order[i]);
+      verify_hash (&h);
+    }
+
+  /* Shrink the table, trying to delete each value twice. */
+  printf (" shrink");
+  shuffle (order, MAX_SIZE);
+  for (i = 0; i < MAX_SIZE; i++)
+    {
+      do_delete (&h, order[i]);
+      do_delete (&h, order[i]);
+      verify_hash (&h);
+    }
+  ASSERT (hash_empty (&h));
+  ASSERT (h.slot_cnt < max_slot_cnt);
+
+  /* Random operations.  Half of them are insertions, so that
+     the table keeps growing and shrinking around half full. */
+  printf (" random");
+  for (i = 0; i < RANDOM_OPS; i++)
+    {
+      int value = random_ulong () % MAX_SIZE;
+
+      switch (random_ulong () % 6)
+        {
+        case 0:
+        case 1:
+        case 2:
+          do_insert (&h, value);
+          break;
+        case 3:
+          do_replace (&h, value);
+          break;
+        case 4:
+          do_delete (&h, value);
+          break;
+        case 5:
+          do_find (&h, value);
+          break;
+        }
+      verify_hash (&h);
+    }
+
+  /* Every kind of operation must have run into a resize. */
+  ASSERT (resizing_inserts > 0);
+  ASSERT (resizing_replaces > 0);
+  ASSERT (resizing_deletes > 0);
+  ASSERT (resizing_finds > 0);
+
+  hash_clear (&h, NULL);
+  for (i = 0; i < MAX_SIZE; i++)
+    in_table[i] = NULL;
+  in_cnt = 0;
+  verify_hash (&h);
+  hash_destroy (&h, NULL);
+  printf (" done\n");
+}
+
+/* Inserts VALUE into H with hash_insert() and checks the
+   result. */
+static void
+do_insert (struct hash *h, int value)
+{
+  struct value *v = &values[random_ulong () % 2][value];
+  struct hash_elem *old;
+
+  if (h->old_slots != NULL)
+    resizing_inserts++;
+  old = hash_insert (h, &v->elem);
+  if (in_table[value] != NULL)
+    ASSERT (old == &in_table[value]->elem);
+  else
+    {
+      ASSERT (old == NULL);
+      in_table[value] = v;
+      in_cnt++;
+    }
+}
+
+/* Puts VALUE into H with hash_replace(), using the other element
+   for VALUE from the one already in H, if any, and checks the
+   result. */
+static void
+do_replace (struct hash *h, int value)
+{
+  struct value *v;
+  struct hash_elem *old;
+
+  if (in_table[value] == &values[0][value])
+    v = &values[1][value];
+  else
+    v = &values[0][value];
+
+  if (h->old_slots != NULL)
+    resizing_replaces++;
+  old = hash_replace (h, &v->elem);
+  if (in_table[value] != NULL)
+    ASSERT (old == &in_table[value]->elem);
+  else
+    {
+      ASSERT (old == NULL);
+      in_cnt++;
+    }
+  in_table[value] = v;
+}
+
+/* Deletes VALUE from H with hash_delete(), looking it up by the
+   element that is not in H, and checks the result. */
+static void
+do_delete (struct hash *h, int value)
+{
+  struct value key;
+  struct hash_elem *old;
+
+  key.value = value;
+  if (h->old_slots != NULL)
+    resizing_deletes++;
+  old = hash_delete (h, &key.elem);
+  if (in_table[value] != NULL)
+    {
+      ASSERT (old == &in_table[value]->elem);
+      in_table[value] = NULL;
+      in_cnt--;
+    }
+  else
+    ASSERT (old == NULL);
+}
+
+/* Looks up VALUE in H with hash_find() and checks the result. */
+static void
+do_find (struct hash *h, int value)
+{
+  struct value key;
+  struct hash_elem *e;
+
+  key.value = value;
+  if (h->old_slots != NULL)
+    resizing_finds++;
+  e = hash_find (h, &key.elem);
+  ASSERT (in_table[value] != NULL ? e == &in_table[value]->elem : e == NULL);
+}
+
+/* Verifies that H contains exactly the elements in IN_TABLE,
+   both by looking up every value and by iterating over H. */
+static void
+verify_hash (struct hash *h)
+{
+  static bool seen[MAX_SIZE];
+  struct hash_iterator i;
+  size_t cnt;
+  int value;
+
+  ASSERT (hash_size (h) == in_cnt);
+  ASSERT (hash_empty (h) == (in_cnt == 0));
+
+  for (value = 0; value < MAX_SIZE; value++)
+    {
+      struct value key;
+      struct hash_elem *e;
+
+      key.value = value;
+      e = hash_find (h, &key.elem);
+      ASSERT (in_table[value] != NULL
+              ? e == &in_table[value]->elem : e == NULL);
+      seen[value] = false;
+    }
+
+  cnt = 0;
+  hash_first (&i, h);
+  while (hash_next (&i))
+    {
+      struct value *v = hash_entry (hash_cur (&i), struct value, elem);
+      ASSERT (v->value >= 0 && v->value < MAX_SIZE);
+      ASSERT (in_table[v->value] == v);
+      ASSERT (!seen[v->value]);
+      seen[v->value] = true;
+      cnt++;
+    }
+  ASSERT (hash_cur (&i) == NULL);
+  ASSERT (cnt == in_cnt);
+}
+
+/* Shuffles the CNT elements in ARRAY into random order. */
+static void
+shuffle (int *array, size_t cnt)
+{
+  size_t i;
+
+  for (i = 0; i < cnt; i++)
+    {
+      size_t j = i + random_ulong () % (cnt - i);
+      int t = array[j];
+      array[j] = array[i];
+      array[i] = t;
+    }
+}
+
+/* Returns a hash of the value of E. */
+static unsigned
+value_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  return hash_int (hash_entry (e, struct value, elem)->value);
+}
+
+/* Returns one of only three hash values for E, chosen to select
+   neighbouring slots, so that most elements collide. */
+static unsigned
+colliding_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  return hash_entry (e, struct value, elem)->value % 3;
+}
+
+/* Returns true if value A is less than value B, false
+   otherwise. */
+static bool
+value_less (const struct hash_elem *a_, const struct hash_elem *b_,
+            void *aux UNUSED)
+{
+  const struct value *a = hash_entry (a_, struct value, elem);
+  const struct value *b = hash_entry (b_, struct value, elem);
+
+  return a->value < b->value;
+}
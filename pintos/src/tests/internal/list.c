@@ -85,6 +85,47 @@ test (void)
                                  value_less, NULL);
           verify_list_fwd (&list, size);
 
+          /* Shuffle, insert using list_insert_ordered_hint()
+             with random hints, and verify ordering. */
+          shuffle (values, size);
+          list_init (&list);
+          e = list_end (&list);
+          for (i = 0; i < size; i++)
+            {
+              if (random_ulong () % 2)
+                e = random_ulong () % 2 ? list_begin (&list) : list_end (&list);
+              list_insert_ordered_hint (&list, &values[i].elem, e,
+                                        value_less, NULL);
+              e = &values[i].elem;
+            }
+          verify_list_fwd (&list, size);
+
+          /* Move the list into a sized list and check its size as
+             it empties. */
+          {
+            struct sized_list sl;
+
+            sized_list_init (&sl);
+            while (!list_empty (&list))
+              sized_list_push_back (&sl, list_pop_front (&list));
+            ASSERT (sized_list_size (&sl) == (size_t) size);
+            verify_list_fwd (&sl.list, size);
+            for (i = size; i > 0; i--)
+              {
+                ASSERT (sized_list_size (&sl) == list_size (&sl.list));
+                if (i % 2)
+                  sized_list_pop_front (&sl);
+                else
+                  sized_list_pop_back (&sl);
+              }
+            ASSERT (sized_list_size (&sl) == 0 && list_empty (&sl.list));
+          }
+
+          /* Rebuild the sorted list for the uniquify test. */
+          list_init (&list);
+          for (i = 0; i < size; i++)
+            list_insert_ordered (&list, &values[i].elem, value_less, NULL);
+
           /* Duplicate some items, uniquify, and verify. */
           ofs = size;
           for (e = list_begin (&list); e != list_end (&list);
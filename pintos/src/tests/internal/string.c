@@ -0,0 +1,199 @@
+/* Test program for the block functions in lib/string.c.
+
+   Checks memcpy(), memmove(), memset() and memcmp() against
+   byte-at-a-time versions for every small size and alignment,
+   then times page-sized copies and fills against those versions
+   and prints the speedup.
+
+   This is not a test we will run on your submitted projects.
+   It is here for completeness.
+*/
+
+#undef NDEBUG
+#include <debug.h>
+#include <inttypes.h>
+#include <random.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "threads/test.h"
+#include "threads/vaddr.h"
+
+/* Largest block we check at every alignment. */
+#define MAX_SIZE 80
+
+/* Slack after a page in each buffer, for misaligned blocks. */
+#define SLACK 16
+
+/* Number of page-sized operations timed in each benchmark. */
+#define BENCH_CNT 4096
+
+static uint8_t src[PGSIZE + SLACK], dst[PGSIZE + SLACK], ref[PGSIZE + SLACK];
+
+static void check_sizes (void);
+static void check_memmove (void);
+static void fill_random (uint8_t *, size_t);
+static void byte_copy (uint8_t *, const uint8_t *, size_t);
+static void byte_move (uint8_t *, const uint8_t *, size_t);
+static void byte_set (uint8_t *, int, size_t);
+static int byte_compare (const uint8_t *, const uint8_t *, size_t);
+static int sign (int);
+static void bench (void);
+
+/* Test the block functions. */
+void
+test (void)
+{
+  check_sizes ();
+  check_memmove ();
+  printf ("block functions match byte-at-a-time versions\n");
+  bench ();
+}
+
+/* Checks memcpy(), memset() and memcmp() for every size up to
+   MAX_SIZE and every alignment of source and destination, plus
+   a whole page. */
+static void
+check_sizes (void)
+{
+  size_t size, s_ofs, d_ofs;
+
+  for (size = 0; size <= MAX_SIZE; size++)
+    for (s_ofs = 0; s_ofs < 4; s_ofs++)
+      for (d_ofs = 0; d_ofs < 4; d_ofs++)
+        {
+          size_t i;
+
+          fill_random (src, sizeof src);
+          fill_random (dst, sizeof dst);
+          byte_copy (ref, dst, sizeof ref);
+
+          ASSERT (memcpy (dst + d_ofs, src + s_ofs, size) == dst + d_ofs);
+          byte_copy (ref + d_ofs, src + s_ofs, size);
+          ASSERT (byte_compare (dst, ref, sizeof ref) == 0);
+
+          ASSERT (memset (dst + d_ofs, s_ofs * 0x55, size) == dst + d_ofs);
+          byte_set (ref + d_ofs, s_ofs * 0x55, size);
+          ASSERT (byte_compare (dst, ref, sizeof ref) == 0);
+
+          ASSERT (memcmp (dst + d_ofs, ref + d_ofs, size) == 0);
+          for (i = 0; i < size; i++)
+            {
+              dst[d_ofs + i] ^= 1 << (i % 8);
+              ASSERT (sign (memcmp (dst + d_ofs, ref + d_ofs, size))
+                      == sign (byte_compare (dst + d_ofs, ref + d_ofs,
+                                             size)));
+              dst[d_ofs + i] ^= 1 << (i % 8);
+            }
+        }
+
+  fill_random (src, sizeof src);
+  memcpy (dst + 1, src + 3, PGSIZE);
+  ASSERT (byte_compare (dst + 1, src + 3, PGSIZE) == 0);
+}
+
+/* Checks memmove() on overlapping blocks in both directions. */
+static void
+check_memmove (void)
+{
+  size_t size;
+  int shift;
+
+  for (size = 0; size <= MAX_SIZE; size++)
+    for (shift = -SLACK / 2; shift <= SLACK / 2; shift++)
+      {
+        uint8_t *p = dst + SLACK / 2;
+
+        fill_random (dst, sizeof dst);
+        byte_copy (ref, dst, sizeof ref);
+
+        ASSERT (memmove (p + shift, p, size) == p + shift);
+        byte_move (ref + SLACK / 2 + shift, ref + SLACK / 2, size);
+        ASSERT (byte_compare (dst, ref, sizeof ref) == 0);
+      }
+}
+
+/* Fills the SIZE bytes at P with random data. */
+static void
+fill_random (uint8_t *p, size_t size)
+{
+  random_bytes (p, size);
+}
+
+/* Reference versions, a byte at a time. */
+static void
+byte_copy (uint8_t *d, const uint8_t *s, size_t size)
+{
+  while (size-- > 0)
+    *d++ = *s++;
+}
+
+static void
+byte_move (uint8_t *d, const uint8_t *s, size_t size)
+{
+  if (d < s)
+    byte_copy (d, s, size);
+  else
+    while (size-- > 0)
+      d[size] = s[size];
+}
+
+static void
+byte_set (uint8_t *d, int value, size_t size)
+{
+  while (size-- > 0)
+    *d++ = value;
+}
+
+static int
+byte_compare (const uint8_t *a, const uint8_t *b, size_t size)
+{
+  for (; size-- > 0; a++, b++)
+    if (*a != *b)
+      return *a > *b ? +1 : -1;
+  return 0;
+}
+
+/* Returns -1, 0, or +1 according to the sign of X. */
+static int
+sign (int x)
+{
+  return (x > 0) - (x < 0);
+}
+
+/* Times BENCH_CNT page copies and fills with the library and the
+   reference versions and prints the ratio. */
+static void
+bench (void)
+{
+  int64_t start, lib_ticks, ref_ticks;
+  int i;
+
+  start = timer_ticks ();
+  for (i = 0; i < BENCH_CNT; i++)
+    memcpy (dst, src, PGSIZE);
+  lib_ticks = timer_elapsed (start);
+
+  start = timer_ticks ();
+  for (i = 0; i < BENCH_CNT; i++)
+    byte_copy (dst, src, PGSIZE);
+  ref_ticks = timer_elapsed (start);
+
+  printf ("memcpy: %d pages in %"PRId64" ticks, byte loop %"PRId64" ticks "
+          "(%"PRId64"x)\n", BENCH_CNT, lib_ticks, ref_ticks,
+          ref_ticks / (lib_ticks > 0 ? lib_ticks : 1));
+
+  start = timer_ticks ();
+  for (i = 0; i < BENCH_CNT; i++)
+    memset (dst, i, PGSIZE);
+  lib_ticks = timer_elapsed (start);
+
+  start = timer_ticks ();
+  for (i = 0; i < BENCH_CNT; i++)
+    byte_set (dst, i, PGSIZE);
+  ref_ticks = timer_elapsed (start);
+
+  printf ("memset: %d pages in %"PRId64" ticks, byte loop %"PRId64" ticks "
+          "(%"PRId64"x)\n", BENCH_CNT, lib_ticks, ref_ticks,
+          ref_ticks / (lib_ticks > 0 ? lib_ticks : 1));
+}
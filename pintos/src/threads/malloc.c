@@ -1,10 +1,12 @@
 #include "threads/malloc.h"
 #include <debug.h>
+#include <limits.h>
 #include <list.h>
 #include <round.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/interrupt.h"
 #include "threads/palloc.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
@@ -25,8 +27,18 @@
 
    When we free a block, we add it to its descriptor's free list.
    But if the arena that the block was in now has no in-use
-   blocks, we remove all of the arena's blocks from the free list
-   and give the arena back to the page allocator.
+   blocks, and the descriptor already has SPARE_ARENAS such
+   arenas, we remove all of the arena's blocks from the free list
+   and give the arena back to the page allocator.  Keeping a spare
+   stops a block that is allocated and freed over and over from
+   taking a page from the page allocator each time.
+
+   In front of each free list is a "magazine", a small stack of
+   blocks freed recently.  malloc() and free() use the magazine
+   when they can, with interrupts disabled instead of the
+   descriptor lock, which makes the common case a handful of
+   instructions.  Blocks in a magazine count as in use in their
+   arenas.
 
    We can't handle blocks bigger than 2 kB using this scheme,
    because they're too big to fit in a single page with a
@@ -34,6 +46,15 @@
    with the page allocator and sticking the allocation size at
    the beginning of the allocated block's arena header. */
 
+/* Smallest block size.  Must be a power of 2. */
+#define MIN_BLOCK_SIZE 16
+
+/* Number of blocks a magazine holds. */
+#define MAGAZINE_SIZE 8
+
+/* Number of empty arenas a descriptor keeps. */
+#define SPARE_ARENAS 1
+
 /* Descriptor. */
 struct desc
   {
@@ -41,6 +62,11 @@ struct desc
     size_t blocks_per_arena;    /* Number of blocks in an arena. */
     struct list free_list;      /* List of free blocks. */
     struct lock lock;           /* Lock. */
+    size_t empty_cnt;           /* Arenas with no blocks in use. */
+
+    /* Recently freed blocks, protected by disabling interrupts. */
+    void *magazine[MAGAZINE_SIZE];
+    size_t magazine_cnt;
   };
 
 /* Magic number for detecting arena corruption. */
@@ -66,6 +92,7 @@ static size_t desc_cnt;         /* Number of descriptors. */
 
 static struct arena *block_to_arena (struct block *);
 static struct block *arena_to_block (struct arena *, size_t idx);
+static struct desc *size_to_desc (size_t size);
 
 /* Initializes the malloc() descriptors. */
 void
@@ -73,7 +100,8 @@ malloc_init (void)
 {
   size_t block_size;
 
-  for (block_size = 16; block_size < PGSIZE / 2; block_size *= 2)
+  for (block_size = MIN_BLOCK_SIZE; block_size < PGSIZE / 2;
+       block_size *= 2)
     {
       struct desc *d = &descs[desc_cnt++];
       ASSERT (desc_cnt <= sizeof descs / sizeof *descs);
@@ -81,6 +109,8 @@ malloc_init (void)
       d->blocks_per_arena = (PGSIZE - sizeof (struct arena)) / block_size;
       list_init (&d->free_list);
       lock_init (&d->lock);
+      d->empty_cnt = 0;
+      d->magazine_cnt = 0;
     }
 }
 
@@ -92,6 +122,7 @@ malloc (size_t size)
   struct desc *d;
   struct block *b;
   struct arena *a;
+  enum intr_level old_level;
 
   /* A null pointer satisfies a request for 0 bytes. */
   if (size == 0)
@@ -99,10 +130,8 @@ malloc (size_t size)
 
   /* Find the smallest descriptor that satisfies a SIZE-byte
      request. */
-  for (d = descs; d < descs + desc_cnt; d++)
-    if (d->block_size >= size)
-      break;
-  if (d == descs + desc_cnt) 
+  d = size_to_desc (size);
+  if (d == NULL) 
     {
       /* SIZE is too big for any descriptor.
          Allocate enough pages to hold SIZE plus an arena. */
@@ -119,6 +148,13 @@ malloc (size_t size)
       return a + 1;
     }
 
+  /* Take a recently freed block if there is one. */
+  old_level = intr_disable ();
+  b = d->magazine_cnt > 0 ? d->magazine[--d->magazine_cnt] : NULL;
+  intr_set_level (old_level);
+  if (b != NULL)
+    return b;
+
   lock_acquire (&d->lock);
 
   /* If the free list is empty, create a new arena. */
@@ -138,6 +174,7 @@ malloc (size_t size)
       a->magic = ARENA_MAGIC;
       a->desc = d;
       a->free_cnt = d->blocks_per_arena;
+      d->empty_cnt++;
       for (i = 0; i < d->blocks_per_arena; i++) 
         {
           struct block *b = arena_to_block (a, i);
@@ -148,7 +185,8 @@ malloc (size_t size)
   /* Get a block from free list and return it. */
   b = list_entry (list_pop_front (&d->free_list), struct block, free_elem);
   a = block_to_arena (b);
-  a->free_cnt--;
+  if (a->free_cnt-- == d->blocks_per_arena)
+    d->empty_cnt--;
   lock_release (&d->lock);
   return b;
 }
@@ -228,18 +266,32 @@ free (void *p)
         {
           /* It's a normal block.  We handle it here. */
 
+          enum intr_level old_level;
+          bool cached;
+
 #ifndef NDEBUG
           /* Clear the block to help detect use-after-free bugs. */
           memset (b, 0xcc, d->block_size);
 #endif
+
+          /* Keep the block in the magazine if there is room. */
+          old_level = intr_disable ();
+          cached = d->magazine_cnt < MAGAZINE_SIZE;
+          if (cached)
+            d->magazine[d->magazine_cnt++] = b;
+          intr_set_level (old_level);
+          if (cached)
+            return;
   
           lock_acquire (&d->lock);
 
           /* Add block to free list. */
           list_push_front (&d->free_list, &b->free_elem);
 
-          /* If the arena is now entirely unused, free it. */
-          if (++a->free_cnt >= d->blocks_per_arena) 
+          /* If the arena is now entirely unused, free it, unless
+             it is the only spare. */
+          if (++a->free_cnt >= d->blocks_per_arena
+              && ++d->empty_cnt > SPARE_ARENAS) 
             {
               size_t i;
 
@@ -249,6 +301,7 @@ free (void *p)
                   struct block *b = arena_to_block (a, i);
                   list_remove (&b->free_elem);
                 }
+              d->empty_cnt--;
               palloc_free_page (a);
             }
 
@@ -263,6 +316,23 @@ free (void *p)
     }
 }
 
+/* Returns the smallest descriptor whose blocks hold SIZE bytes,
+   or a null pointer if SIZE is too big for any descriptor.
+   Block sizes are consecutive powers of 2, so the index is the
+   base-2 logarithm of SIZE rounded up, less that of the smallest
+   size. */
+static struct desc *
+size_to_desc (size_t size) 
+{
+  size_t idx = 0;
+
+  ASSERT (size > 0);
+  if (size > MIN_BLOCK_SIZE)
+    idx = (sizeof (unsigned) * CHAR_BIT - __builtin_clz (size - 1)
+           - __builtin_ctz (MIN_BLOCK_SIZE));
+  return idx < desc_cnt ? &descs[idx] : NULL;
+}
+
 /* Returns the arena that block B is inside. */
 static struct arena *
 block_to_arena (struct block *b)
@@ -7,6 +7,7 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/interrupt.h"
 #include "threads/loader.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
@@ -23,7 +24,36 @@
 
    By default, half of system RAM is given to the kernel pool and
    half to the user pool.  That should be huge overkill for the
-   kernel pool, but that's just fine for demonstration purposes. */
+   kernel pool, but that's just fine for demonstration purposes.
+
+   The bitmap is the only authority on which pages are free.  Two
+   hints keep allocation from searching it from the start every
+   time.  Each freed run is remembered in a small stack for its
+   size class, so most allocations, and nearly all single-page
+   ones, reuse a recent run without searching at all.  A remembered
+   run may since have been taken by a search, so it is checked
+   against the bitmap before use.  Otherwise the search is next-fit:
+   it starts where the previous one left off and wraps around. */
+
+/* Runs of 1, 2-3, 4-7, ..., 64-127, and 128 or more pages. */
+#define CLASS_CNT 8
+
+/* Number of freed runs remembered per size class. */
+#define RUNS_PER_CLASS 32
+
+/* A run of free pages. */
+struct run
+  {
+    size_t idx;                         /* First page. */
+    size_t cnt;                         /* Number of pages. */
+  };
+
+/* Recently freed runs of one size class, most recent last. */
+struct run_stack
+  {
+    struct run runs[RUNS_PER_CLASS];
+    size_t cnt;
+  };
 
 /* A memory pool. */
 struct pool
@@ -31,6 +61,14 @@ struct pool
     struct lock lock;                   /* Mutual exclusion. */
     struct bitmap *used_map;            /* Bitmap of free pages. */
     uint8_t *base;                      /* Base of pool. */
+    size_t next;                        /* Where the next search starts. */
+    struct run_stack classes[CLASS_CNT]; /* Freed runs, by size class. */
+
+    /* Statistics. */
+    long long alloc_cnt;                /* Pages allocated. */
+    long long free_cnt;                 /* Pages freed. */
+    long long reuse_cnt;                /* Allocations from CLASSES. */
+    long long search_cnt;               /* Allocations by searching. */
   };
 
 /* Two pools: one for kernel data, one for user pages. */
@@ -39,6 +77,9 @@ static struct pool kernel_pool, user_pool;
 static void init_pool (struct pool *, void *base, size_t page_cnt,
                        const char *name);
 static bool page_from_pool (const struct pool *, void *page);
+static size_t take_run (struct pool *, size_t page_cnt);
+static void push_run (struct pool *, size_t idx, size_t page_cnt);
+static void print_pool_stats (const struct pool *, const char *name);
 
 /* Initializes the page allocator.  At most USER_PAGE_LIMIT
    pages are put into the user pool. */
@@ -78,7 +119,25 @@ palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
     return NULL;
 
   lock_acquire (&pool->lock);
-  page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
+  page_idx = take_run (pool, page_cnt);
+  if (page_idx != BITMAP_ERROR)
+    pool->reuse_cnt++;
+  else
+    {
+      page_idx = bitmap_scan_and_flip (pool->used_map, pool->next,
+                                       page_cnt, false);
+      if (page_idx == BITMAP_ERROR && pool->next != 0)
+        page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
+      if (page_idx != BITMAP_ERROR)
+        {
+          pool->next = page_idx + page_cnt;
+          if (pool->next >= bitmap_size (pool->used_map))
+            pool->next = 0;
+          pool->search_cnt++;
+        }
+    }
+  if (page_idx != BITMAP_ERROR)
+    pool->alloc_cnt += page_cnt;
   lock_release (&pool->lock);
 
   if (page_idx != BITMAP_ERROR)
@@ -119,6 +178,7 @@ palloc_free_multiple (void *pages, size_t page_cnt)
 {
   struct pool *pool;
   size_t page_idx;
+  enum intr_level old_level;
 
   ASSERT (pg_ofs (pages) == 0);
   if (pages == NULL || page_cnt == 0)
@@ -139,6 +199,14 @@ palloc_free_multiple (void *pages, size_t page_cnt)
 
   ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
   bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+
+  /* We may be called with interrupts off, from the scheduler, so we
+     can't take the pool lock.  Disabling interrupts is enough to
+     keep the hints and statistics consistent. */
+  old_level = intr_disable ();
+  push_run (pool, page_idx, page_cnt);
+  pool->free_cnt += page_cnt;
+  intr_set_level (old_level);
 }
 
 /* Frees the page at PAGE. */
@@ -148,6 +216,14 @@ palloc_free_page (void *page)
   palloc_free_multiple (page, 1);
 }
 
+/* Prints page allocator statistics. */
+void
+palloc_print_stats (void) 
+{
+  print_pool_stats (&kernel_pool, "kernel");
+  print_pool_stats (&user_pool, "user");
+}
+
 /* Initializes pool P as starting at START and ending at END,
    naming it NAME for debugging purposes. */
 static void
@@ -167,6 +243,10 @@ init_pool (struct pool *p, void *base, size_t page_cnt, const char *name)
   lock_init (&p->lock);
   p->used_map = bitmap_create_in_buf (page_cnt, base, bm_pages * PGSIZE);
   p->base = base + bm_pages * PGSIZE;
+  p->next = 0;
+  memset (p->classes, 0, sizeof p->classes);
+  p->alloc_cnt = p->free_cnt = 0;
+  p->reuse_cnt = p->search_cnt = 0;
 }
 
 /* Returns true if PAGE was allocated from POOL,
@@ -180,3 +260,94 @@ page_from_pool (const struct pool *pool, void *page)
 
   return page_no >= start_page && page_no < end_page;
 }
+
+/* Returns the size class of a run of PAGE_CNT pages. */
+static int
+size_class (size_t page_cnt) 
+{
+  int class = 0;
+
+  while (page_cnt > 1 && class < CLASS_CNT - 1)
+    {
+      page_cnt >>= 1;
+      class++;
+    }
+  return class;
+}
+
+/* Removes entry IDX from stack S. */
+static void
+remove_run (struct run_stack *s, size_t idx) 
+{
+  s->runs[idx] = s->runs[--s->cnt];
+}
+
+/* Looks for a remembered run of at least PAGE_CNT pages in POOL
+   that is still free.  If there is one, marks its first PAGE_CNT
+   pages used, remembers the rest, and returns the index of its
+   first page.  Otherwise, returns BITMAP_ERROR.  Runs found to be
+   no longer free are forgotten along the way. */
+static size_t
+take_run (struct pool *pool, size_t page_cnt) 
+{
+  size_t found = BITMAP_ERROR;
+  enum intr_level old_level;
+  int class;
+
+  old_level = intr_disable ();
+  for (class = size_class (page_cnt);
+       class < CLASS_CNT && found == BITMAP_ERROR; class++)
+    {
+      struct run_stack *s = &pool->classes[class];
+      size_t i = s->cnt;
+
+      while (i-- > 0)
+        {
+          struct run r = s->runs[i];
+
+          if (r.cnt < page_cnt)
+            continue;
+          remove_run (s, i);
+          if (bitmap_contains (pool->used_map, r.idx, page_cnt, true))
+            continue;
+
+          bitmap_set_multiple (pool->used_map, r.idx, page_cnt, true);
+          if (r.cnt > page_cnt)
+            push_run (pool, r.idx + page_cnt, r.cnt - page_cnt);
+          found = r.idx;
+          break;
+        }
+    }
+  intr_set_level (old_level);
+
+  return found;
+}
+
+/* Remembers that the PAGE_CNT pages starting at IDX in POOL were
+   freed.  If the stack for their size class is full, the run is
+   left for searches to find.  Must be called with interrupts
+   off. */
+static void
+push_run (struct pool *pool, size_t idx, size_t page_cnt) 
+{
+  struct run_stack *s = &pool->classes[size_class (page_cnt)];
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (s->cnt < RUNS_PER_CLASS)
+    {
+      s->runs[s->cnt].idx = idx;
+      s->runs[s->cnt].cnt = page_cnt;
+      s->cnt++;
+    }
+}
+
+/* Prints statistics for POOL, calling it NAME. */
+static void
+print_pool_stats (const struct pool *pool, const char *name) 
+{
+  printf ("Palloc: %s pool: %lld pages allocated, %lld freed, "
+          "%lld reused, %lld searched\n",
+          name, pool->alloc_cnt, pool->free_cnt,
+          pool->reuse_cnt, pool->search_cnt);
+}
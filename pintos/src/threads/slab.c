@@ -0,0 +1,228 @@
+#include "threads/slab.h"
+#include <debug.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+/* Object caches.
+
+   Each slab is one page.  A header at the start of the page
+   points back to the cache and heads a singly linked list of the
+   slab's free objects; the objects fill the rest of the page.  A
+   free object holds the link to the next one in its first bytes,
+   so objects must be at least pointer-sized.
+
+   A cache keeps the slabs that have free objects on its PARTIAL
+   list and takes objects from the first of them, so allocations
+   fill one slab before moving to the next.  Full slabs are on no
+   list.  When a slab's last object is freed, the cache keeps it
+   as a spare if it has none, and otherwise gives the page back.
+
+   The constructor, if any, runs on every object slab_alloc()
+   returns, so callers get objects in a known state. */
+
+/* Number of empty slabs a cache keeps. */
+#define SPARE_SLABS 1
+
+/* Magic number for detecting slab corruption. */
+#define SLAB_MAGIC 0x51ab51ab
+
+/* Slab header. */
+struct slab
+  {
+    unsigned magic;             /* Always set to SLAB_MAGIC. */
+    struct slab_cache *cache;   /* Owning cache. */
+    struct list_elem elem;      /* Element in cache's PARTIAL list. */
+    struct free_obj *free;      /* First free object. */
+    size_t in_use;              /* Objects handed out. */
+  };
+
+/* Free object. */
+struct free_obj
+  {
+    struct free_obj *next;      /* Next free object in its slab. */
+  };
+
+/* All caches, for statistics. */
+static struct list all_caches = LIST_INITIALIZER (all_caches);
+
+static struct slab *new_slab (struct slab_cache *);
+static struct slab *obj_to_slab (struct slab_cache *, void *);
+
+/* Initializes C as a cache of SIZE-byte objects called NAME.  If
+   CTOR is nonnull, it is called on each object slab_alloc()
+   returns.  Allocates nothing, so this is safe to call before the
+   page allocator is ready. */
+void
+slab_cache_init (struct slab_cache *c, const char *name, size_t size,
+                 void (*ctor) (void *))
+{
+  ASSERT (c != NULL);
+  ASSERT (size > 0);
+
+  if (size < sizeof (struct free_obj))
+    size = sizeof (struct free_obj);
+  c->name = name;
+  c->obj_size = ROUND_UP (size, sizeof (void *));
+  c->objs_per_slab = (PGSIZE - sizeof (struct slab)) / c->obj_size;
+  ASSERT (c->objs_per_slab > 0);
+  c->ctor = ctor;
+  lock_init (&c->lock);
+  list_init (&c->partial);
+  c->empty_cnt = 0;
+  c->slab_cnt = 0;
+  c->in_use = 0;
+  c->alloc_cnt = 0;
+  list_push_back (&all_caches, &c->elem);
+}
+
+/* Obtains and returns an object from C.  Returns a null pointer
+   if memory is not available. */
+void *
+slab_alloc (struct slab_cache *c)
+{
+  struct slab *s;
+  struct free_obj *obj;
+
+  lock_acquire (&c->lock);
+
+  /* If no slab has a free object, create a new slab. */
+  if (list_empty (&c->partial))
+    {
+      s = new_slab (c);
+      if (s == NULL)
+        {
+          lock_release (&c->lock);
+          return NULL;
+        }
+      list_push_front (&c->partial, &s->elem);
+    }
+
+  /* Take an object from the first slab that has one. */
+  s = list_entry (list_front (&c->partial), struct slab, elem);
+  obj = s->free;
+  s->free = obj->next;
+  if (s->in_use++ == 0)
+    c->empty_cnt--;
+  if (s->free == NULL)
+    list_remove (&s->elem);
+  c->in_use++;
+  c->alloc_cnt++;
+
+  lock_release (&c->lock);
+
+  if (c->ctor != NULL)
+    c->ctor (obj);
+  return obj;
+}
+
+/* Returns OBJ, which must have been obtained from C with
+   slab_alloc(), to C.  A null OBJ is ignored. */
+void
+slab_free (struct slab_cache *c, void *obj_)
+{
+  struct free_obj *obj = obj_;
+  struct slab *s;
+
+  if (obj == NULL)
+    return;
+  s = obj_to_slab (c, obj);
+
+#ifndef NDEBUG
+  /* Clear the object to help detect use-after-free bugs. */
+  memset (obj, 0xcc, c->obj_size);
+#endif
+
+  lock_acquire (&c->lock);
+
+  /* Put the object back on its slab's free list.  A slab that was
+     full becomes partial again. */
+  if (s->free == NULL)
+    list_push_front (&c->partial, &s->elem);
+  obj->next = s->free;
+  s->free = obj;
+  c->in_use--;
+
+  /* If the slab is now entirely unused, free it, unless it is the
+     only spare. */
+  if (--s->in_use == 0 && ++c->empty_cnt > SPARE_SLABS)
+    {
+      list_remove (&s->elem);
+      c->empty_cnt--;
+      c->slab_cnt--;
+      s->magic = 0;
+      palloc_free_page (s);
+    }
+
+  lock_release (&c->lock);
+}
+
+/* Prints statistics for every cache. */
+void
+slab_print_stats (void)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&all_caches); e != list_end (&all_caches);
+       e = list_next (e))
+    {
+      struct slab_cache *c = list_entry (e, struct slab_cache, elem);
+      printf ("Slab: %s: %zu in use, %zu slabs of %zu, %lld allocated\n",
+              c->name, c->in_use, c->slab_cnt, c->objs_per_slab,
+              c->alloc_cnt);
+    }
+}
+
+/* Allocates a slab for C with all of its objects free.  Returns a
+   null pointer if memory is not available. */
+static struct slab *
+new_slab (struct slab_cache *c)
+{
+  struct slab *s = palloc_get_page (0);
+  uint8_t *obj;
+  size_t i;
+
+  if (s == NULL)
+    return NULL;
+
+  s->magic = SLAB_MAGIC;
+  s->cache = c;
+  s->in_use = 0;
+
+  /* Link the objects so that they are handed out in address
+     order. */
+  s->free = NULL;
+  obj = (uint8_t *) (s + 1) + c->objs_per_slab * c->obj_size;
+  for (i = 0; i < c->objs_per_slab; i++)
+    {
+      struct free_obj *f;
+
+      obj -= c->obj_size;
+      f = (struct free_obj *) obj;
+      f->next = s->free;
+      s->free = f;
+    }
+
+  c->slab_cnt++;
+  c->empty_cnt++;
+  return s;
+}
+
+/* Returns the slab that OBJ, an object of C, is in. */
+static struct slab *
+obj_to_slab (struct slab_cache *c, void *obj)
+{
+  struct slab *s = pg_round_down (obj);
+
+  /* Check that the slab is valid and belongs to C. */
+  ASSERT (s->magic == SLAB_MAGIC);
+  ASSERT (s->cache == c);
+
+  /* Check that the object is properly aligned for the slab. */
+  ASSERT ((pg_ofs (obj) - sizeof *s) % c->obj_size == 0);
+
+  return s;
+}
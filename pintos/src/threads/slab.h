@@ -0,0 +1,39 @@
+#ifndef THREADS_SLAB_H
+#define THREADS_SLAB_H
+
+#include <list.h>
+#include <stddef.h>
+#include "threads/synch.h"
+
+/* A cache of objects of one type.
+
+   Objects are carved out of whole pages ("slabs") obtained from
+   the page allocator, packed at their own size rather than
+   rounded up to a power of 2 as malloc() would, so objects of one
+   type sit together.  Each slab keeps a list of its free objects.
+
+   The members are private to slab.c. */
+struct slab_cache
+  {
+    const char *name;           /* For statistics. */
+    size_t obj_size;            /* Size of each object, rounded up. */
+    size_t objs_per_slab;       /* Objects that fit in a slab. */
+    void (*ctor) (void *);      /* Initializes each object handed out. */
+    struct lock lock;           /* Protects the members below. */
+    struct list partial;        /* Slabs with at least one free object. */
+    size_t empty_cnt;           /* Slabs with no objects in use. */
+    struct list_elem elem;      /* Element in the list of all caches. */
+
+    /* Statistics. */
+    size_t slab_cnt;            /* Slabs allocated. */
+    size_t in_use;              /* Objects in use. */
+    long long alloc_cnt;        /* Objects ever handed out. */
+  };
+
+void slab_cache_init (struct slab_cache *, const char *name, size_t size,
+                      void (*ctor) (void *));
+void *slab_alloc (struct slab_cache *);
+void slab_free (struct slab_cache *, void *);
+void slab_print_stats (void);
+
+#endif /* threads/slab.h */
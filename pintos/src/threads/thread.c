@@ -11,6 +11,7 @@
 #include "threads/synch.h"
 #include "threads/vaddr.h"
 #include "threads/pte.h"
+#include "threads/slab.h"
 #include "threads/thread.h"
 #include "userprog/process.h"
 #include "vm/page.h"
@@ -44,6 +45,9 @@ static struct thread *initial_thread;
 /* Lock used by allocate_tid(). */
 static struct lock tid_lock;
 
+/* Records of the children of each process, for wait(). */
+static struct slab_cache child_cache;
+
 /* Stack frame for kernel_thread(). */
 struct kernel_thread_frame 
   {
@@ -79,37 +83,10 @@ void thread_sleep(int64_t start, int64_t duration);
 void thread_schedule_tail (struct thread *prev);
 static void wake_up_thread (struct thread * t, void * aux);
 static tid_t allocate_tid (void);
+static void init_child (void *child_);
 static struct thread *get_highest_priority_thread (void);
 //static int get_priority_of_thread (struct thread * t);
 
-void
-reset_all_accessed_bits (void)
-{
-  // Iterate through processes in all_list
-  struct list_elem *e;
-  for (e = list_begin (&all_list); e != list_end (&all_list); e = list_next (e)) {
-    struct thread *t = list_entry (e, struct thread, allelem);
-    uint32_t *pd = t->pagedir;
-    uint32_t *pde;
-
-    /* Iterate through page directory entries (page tables) 
-       in each thread's page directory */
-    for (pde = pd; pde < pd + pd_no (PHYS_BASE); pde++)
-      if (*pde & PTE_P) { // (PTE_P is defined in pte.h)
-        uint32_t *pt = pde_get_pt (*pde);
-        uint32_t *pte;
-
-        /* Iterate through page table entries (pages)
-           in each page table */
-        for (pte = pt; pte < pt + PGSIZE / sizeof *pte; pte++) {
-          if (*pte & PTE_P) {
-            *pte &= ~(uint32_t) PTE_A; // Set page's accessed bit to 0
-          }
-        }
-      }
-    }
-}
-
 /* Initializes the threading system by transforming the code
    that's currently running into a thread.  This can't work in
    general and it is possible in this case only because loader.S
@@ -139,7 +116,10 @@ thread_init (void)
   initial_thread = running_thread ();
   init_thread (initial_thread, "main", PRI_DEFAULT);
   initialize_ft();
+  initialize_spt();
   //init_st();
+  slab_cache_init (&child_cache, "child processes",
+                   sizeof (struct child_process), init_child);
   initial_thread->status = THREAD_RUNNING;
   initial_thread->tid = allocate_tid ();
 }
@@ -241,7 +221,14 @@ thread_create (const char *name, int priority,
   sf->ebp = 0;
 
   t->parent = thread_current();
-  set_child_of_thread(t->tid);
+  if (!set_child_of_thread(t->tid))
+    {
+      enum intr_level old_level = intr_disable ();
+      list_remove (&t->allelem);
+      intr_set_level (old_level);
+      palloc_free_page (t);
+      return TID_ERROR;
+    }
 
   //init_spt(t->sup_page_table); /* Initialize the Supplemental Page Table. */
 
@@ -593,25 +580,7 @@ init_thread (struct thread *t, const char *name, int priority)
   list_init (&t->donated_priorities);
   list_init (&t->children);
   t->parent = NULL;
-  struct fd_info * fd_array[18];
-
- 
-
-  /*
-  int i;
-  struct fd_info * fdi = malloc(sizeof(struct fd_info));
-  fdi->file = NULL;
-  fdi->slot_is_empty = true;
-  fdi->size = 0;
-  fdi->start_addr = NULL;
-  for (i = 2; i < 18; i++) {
-    t->fd_array[i] = fdi;
-  }
-  */
-  int i;
-  for(i = 0; i < 18; i++){
-    t->fd_array[i] = NULL;
-  }
+  fd_table_init (&t->fd_table);
 
 
   old_level = intr_disable ();
@@ -879,14 +848,28 @@ Sets the specified pid as the child of the current running thread.
 
 */
 
-void
-set_child_of_thread(int pid){
-  struct child_process * child = malloc(sizeof(struct child_process));
-  child->pid = pid;
+/* Gives a new child record the state of a child that is still
+   running and has not been waited for. */
+static void
+init_child (void *child_)
+{
+  struct child_process *child = child_;
   child->exit_status = -1;
   child->wait_called = false;
   child->has_exited = false;
+  sema_init (&child->exited, 0);
+}
+
+/* Records the thread PID as a child of the current thread.  Returns
+   false if out of memory. */
+bool
+set_child_of_thread(int pid){
+  struct child_process * child = slab_alloc(&child_cache);
+  if (child == NULL)
+    return false;
+  child->pid = pid;
   list_push_back(&thread_current()->children, &child->process_element);
+  return true;
 }
 
 struct child_process *
@@ -910,10 +893,11 @@ set_exit_status_of_child(struct thread * parent, int pid, int status){
        e = list_next (e))
     {
       struct child_process * child = list_entry (e, struct child_process, process_element);
-      if (pid == child->pid){
+      if (pid == child->pid && !child->has_exited){
         child->has_exited = true;
         child->exit_status = status;
-
+        /* Wake up the parent if it is waiting in process_wait(). */
+        sema_up(&child->exited);
       }
     }
 }
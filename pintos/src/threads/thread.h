@@ -4,9 +4,11 @@
 #include <debug.h>
 #include <list.h>
 #include <stdint.h>
-#include <hash.h>
 #include "../devices/timer.h"
+#include "threads/synch.h"
+#include "filesys/directory.h"
 #include "vm/frame.h"
+#include "userprog/fdtable.h"
 
 
 /* States in a thread's life cycle. */
@@ -35,7 +37,7 @@ typedef int tid_t;
       void *start_addr;
       //bool slot_is_empty;
       struct file *file;
-      char *file_name;
+      char file_name[NAME_MAX + 1];   // Kernel copy, never a user pointer
       // size, name, begin addr, offset, etc. look at wherever the FD is stored later
     };
 
@@ -113,16 +115,22 @@ struct thread
 
     uint32_t *pagedir;                  /* Page directory. */
     
-    struct fd_info * fd_array[18];       /* The array of file descriptors, indexed by the file descriptor number.
-                                          There are only 16 files in Pintos, but 0 and 1 are reserved fd values. */
+    struct fd_table fd_table;           /* Open files, indexed by file descriptor.
+                                          0 and 1 are reserved for the console. */
     struct thread * parent;
 
     struct list children;
 
-    struct hash sup_page_table;        /* The Supplemental Page Table associated with this thread if it is a user process. */
+    struct spt_entry ***sup_page_table; /* The Supplemental Page Table associated with this thread if it is a user process.
+                                           A page of pointers to pages of entries, indexed like the page directory. */
 
     struct list mmap_table[16];
 
+    uint8_t *stack_bottom;              /* Lowest mapped page of the user stack. */
+    int stack_prefault;                 /* Pages to map on the next stack growth. */
+    size_t stack_limit;                 /* Most pages the user stack may grow to. */
+    void *user_esp;                     /* User stack pointer at the last system call. */
+
 
     /* Owned by thread.c. */
     unsigned magic;                     /* Detects stack overflow. */
@@ -134,6 +142,7 @@ struct child_process {
   bool wait_called;
   struct list_elem process_element;
   bool has_exited;
+  struct semaphore exited;    /* Upped once, when exit_status is set. */
 };
 
 
@@ -159,9 +168,7 @@ struct child_process {
   If we get to this point...
   cp = child_process where cp->pid == B->pid
   cp->wait_called = true;
-  while (!has_exited){
-    
-  }
+  sema_down(&cp->exited);
   return cp->exit_status;
 
 */
@@ -176,6 +183,7 @@ struct child_process {
   p = A->parent->elem (where elem->pid == A->pid)
   p->exit_status = (-1 or passed exit_status)
   p->has_exited = true;
+  sema_up(&p->exited);
   thread_exit();
 
   */
@@ -200,7 +208,7 @@ struct prio {
    Controlled by kernel command-line option "-o mlfqs". */
 extern bool thread_mlfqs;
 
-void set_child_of_thread(int pid);
+bool set_child_of_thread(int pid);
 struct child_process * get_child_of_thread(struct thread * parent, int pid);
 void set_exit_status_of_child(struct thread * parent, int pid, int status);
 
@@ -248,6 +256,5 @@ int thread_get_load_avg (void);
 
 void wake_up_sleeping_threads (void);
 
-void reset_all_accessed_bits (void);
 
 #endif /* threads/thread.h */
\ No newline at end of file
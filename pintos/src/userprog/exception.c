@@ -6,13 +6,20 @@
 #include "threads/thread.h"
 #include "userprog/syscall.h"
 #include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "userprog/process.h"
 #include "vm/page.h"
 
+/* Most pages mapped by a single stack-growth fault, beyond those
+   the process has already moved its stack pointer over. */
+#define STACK_PREFAULT_MAX 16
+
 /* Number of page faults processed. */
 static long long page_fault_cnt;
 
 static void kill (struct intr_frame *);
 static void page_fault (struct intr_frame *);
+static bool grow_stack (void *esp, void *fault_addr);
 
 /* Registers handlers for interrupts that can be caused by user
    programs.
@@ -156,6 +163,11 @@ page_fault (struct intr_frame *f)
      which fault_addr refers. */
 
   bool success = false;
+  if (!not_present && write && is_user_vaddr (fault_addr)
+      && pagedir_is_cow (thread_current ()->pagedir, fault_addr)) {
+    // A write to a page shared with a forked process.
+    success = handle_cow_fault_spt (fault_addr);
+  }
   if(not_present && is_user_vaddr(fault_addr)){
     // At this point we believe that the fault is in error.
     // We should figure out if the fault_addr exists in the supplemental page table
@@ -168,25 +180,75 @@ page_fault (struct intr_frame *f)
       handle_page_fault_spt ( entry );
 
       success = true;
-    } else if (f->esp - 32 <= fault_addr){
-      // We now know that the user needs to grow the stack
-
-      // Check to see if the user has grown the stack too much
-
-      // 8 MB will be our maximum size
-
-      if((PHYS_BASE - pg_round_down(fault_addr)) <= 67108864){
-        // So the user wants to expand the stack
-        // And the user is allowed to.
-        
-        // Now call into the supplemental page table to create a new entry for the user's expanded stack.
-        success = create_entry_spt(fault_addr);
+    } else {
+      // A fault in the kernel, on a system call's user pointer, traps
+      // without a stack switch, so F->esp is not the user's.  Use the
+      // one syscall_handler() saved.
+      void *esp = user ? f->esp : thread_current ()->user_esp;
+      if (esp - 32 <= fault_addr){
+        // We now know that the user needs to grow the stack
+        success = grow_stack (esp, fault_addr);
       }
-
     }
   }
   if(!success){
+    if (!user && is_user_vaddr(fault_addr)) {
+      /* A bad pointer passed to a system call, caught by get_user() or
+         put_user() in syscall.c: resume at the address it left in eax,
+         telling it the access failed. */
+      f->eip = (void (*) (void)) f->eax;
+      f->eax = 0xffffffff;
+      return;
+    }
     system_exit(-1);
   }
 }
 
+/* Grows the current process's stack to cover FAULT_ADDR, an unmapped
+   user address no more than 32 bytes below ESP.
+
+   Everything from the page holding FAULT_ADDR (or ESP, if lower) up
+   to the current bottom of the stack is mapped at once, since the
+   process has already moved its stack pointer over it.  Below that,
+   stack_prefault - 1 more pages are mapped ahead.  That count doubles,
+   up to STACK_PREFAULT_MAX, each time the stack keeps growing straight
+   down from its bottom and drops back to 1 otherwise, so deep
+   recursion takes one fault per several pages instead of one per page.
+
+   Returns true if the faulting page was mapped, false if it lies
+   beyond the process's stack limit or memory ran out. */
+static bool
+grow_stack (void *esp, void *fault_addr)
+{
+  struct thread *t = thread_current ();
+  uint8_t *limit = (uint8_t *) PHYS_BASE - t->stack_limit * PGSIZE;
+  uint8_t *low = pg_round_down (fault_addr < esp ? fault_addr : esp);
+  uint8_t *page;
+
+  if (t->stack_limit > (size_t) PHYS_BASE / PGSIZE || low < limit)
+    return false;
+
+  /* The faulting page has to be mapped; the rest is best effort. */
+  if (!create_entry_spt (pg_round_down (fault_addr)))
+    return false;
+  if (low >= t->stack_bottom)
+    return true;
+
+  if (low == t->stack_bottom - PGSIZE)
+    t->stack_prefault = t->stack_prefault * 2 <= STACK_PREFAULT_MAX
+                        ? t->stack_prefault * 2 : STACK_PREFAULT_MAX;
+  else
+    t->stack_prefault = 1;
+
+  for (page = t->stack_bottom - PGSIZE;
+       page >= limit && page > low - t->stack_prefault * PGSIZE;
+       page -= PGSIZE)
+    {
+      if (pagedir_get_page (t->pagedir, page) == NULL
+          && get_entry_from_vaddr_spt (page) == NULL
+          && !create_entry_spt (page))
+        break;
+      t->stack_bottom = page;
+    }
+  return true;
+}
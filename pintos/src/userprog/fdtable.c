@@ -0,0 +1,176 @@
+#include "userprog/fdtable.h"
+#include <bitmap.h>
+#include <debug.h>
+#include "threads/malloc.h"
+#include "threads/slab.h"
+#include "threads/thread.h"
+
+/* Number of slots allocated by the first open. */
+#define FD_INITIAL 32
+
+/* Open file records, shared by every process's table. */
+static struct slab_cache fd_info_cache;
+
+/* Initializes the cache that open file records come from. */
+void
+fd_info_init (void)
+{
+  slab_cache_init (&fd_info_cache, "open files", sizeof (struct fd_info),
+                   NULL);
+}
+
+/* Returns a new open file record, or a null pointer if memory is
+   exhausted. */
+struct fd_info *
+fd_info_alloc (void)
+{
+  return slab_alloc (&fd_info_cache);
+}
+
+/* Frees INFO, which may be null. */
+void
+fd_info_free (struct fd_info *info)
+{
+  slab_free (&fd_info_cache, info);
+}
+
+/* Initializes T as an empty table.  Allocates nothing, so this is
+   safe to call before malloc() is ready. */
+void
+fd_table_init (struct fd_table *t)
+{
+  t->slots = NULL;
+  t->used = NULL;
+  t->capacity = 0;
+  t->lowest_free = 2;
+}
+
+/* Frees T's memory.  Does not close the files still in it. */
+void
+fd_table_destroy (struct fd_table *t)
+{
+  free (t->slots);
+  if (t->used != NULL)
+    bitmap_destroy (t->used);
+  fd_table_init (t);
+}
+
+/* Grows T to CAPACITY slots.  Returns false if out of memory, in
+   which case T is unchanged. */
+static bool
+grow (struct fd_table *t, int capacity)
+{
+  struct fd_info **slots = calloc (capacity, sizeof *slots);
+  struct bitmap *used = bitmap_create (capacity);
+  int fd;
+
+  if (slots == NULL || used == NULL)
+    {
+      free (slots);
+      if (used != NULL)
+        bitmap_destroy (used);
+      return false;
+    }
+
+  bitmap_mark (used, 0);
+  bitmap_mark (used, 1);
+  for (fd = 2; fd < t->capacity; fd++)
+    if (t->slots[fd] != NULL)
+      {
+        slots[fd] = t->slots[fd];
+        bitmap_mark (used, fd);
+      }
+
+  free (t->slots);
+  if (t->used != NULL)
+    bitmap_destroy (t->used);
+  t->slots = slots;
+  t->used = used;
+  t->capacity = capacity;
+  return true;
+}
+
+/* Stores INFO under the lowest free descriptor in T and returns it,
+   or -1 if T is full or memory is exhausted. */
+int
+fd_table_add (struct fd_table *t, struct fd_info *info)
+{
+  int fd = t->lowest_free;
+
+  return fd_table_put (t, fd, info) ? fd : -1;
+}
+
+/* Stores INFO under descriptor FD in T, which must be free.  Returns
+   false if FD is out of range or memory is exhausted. */
+bool
+fd_table_put (struct fd_table *t, int fd, struct fd_info *info)
+{
+  ASSERT (info != NULL);
+
+  if (fd < 2 || fd >= FD_MAX)
+    return false;
+  if (fd >= t->capacity)
+    {
+      int capacity = t->capacity == 0 ? FD_INITIAL : t->capacity;
+      while (capacity <= fd)
+        capacity *= 2;
+      if (capacity > FD_MAX)
+        capacity = FD_MAX;
+      if (!grow (t, capacity))
+        return false;
+    }
+
+  ASSERT (t->slots[fd] == NULL);
+  t->slots[fd] = info;
+  bitmap_mark (t->used, fd);
+
+  if (fd == t->lowest_free)
+    {
+      /* Everything below FD is in use, so the search starts after it. */
+      size_t next = bitmap_scan (t->used, fd + 1, 1, false);
+      t->lowest_free = next != BITMAP_ERROR ? (int) next : t->capacity;
+    }
+  return true;
+}
+
+/* Returns the file open as FD in T, or NULL if there is none. */
+struct fd_info *
+fd_table_get (const struct fd_table *t, int fd)
+{
+  if (fd < 2 || fd >= t->capacity)
+    return NULL;
+  return t->slots[fd];
+}
+
+/* Removes FD from T and returns the file that was open as FD, or
+   NULL if there was none. */
+struct fd_info *
+fd_table_remove (struct fd_table *t, int fd)
+{
+  struct fd_info *info = fd_table_get (t, fd);
+
+  if (info != NULL)
+    {
+      t->slots[fd] = NULL;
+      bitmap_reset (t->used, fd);
+      if (fd < t->lowest_free)
+        t->lowest_free = fd;
+    }
+  return info;
+}
+
+/* Returns the lowest open descriptor in T that is at least FD, or -1
+   if there is none. */
+int
+fd_table_next (const struct fd_table *t, int fd)
+{
+  size_t next;
+
+  if (fd < 2)
+    fd = 2;
+  if (fd >= t->capacity)
+    return -1;
+
+  next = bitmap_scan (t->used, fd, 1, true);
+  return next != BITMAP_ERROR ? (int) next : -1;
+}
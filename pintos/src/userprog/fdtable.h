@@ -0,0 +1,40 @@
+#ifndef USERPROG_FDTABLE_H
+#define USERPROG_FDTABLE_H
+
+#include <stdbool.h>
+
+struct fd_info;
+struct bitmap;
+
+/* Most files one process may have open at once. */
+#define FD_MAX 1024
+
+/* A process's open files, indexed by file descriptor.  0 and 1 are
+   the console and never hold a file.
+
+   The slots and the bitmap of descriptors in use are allocated on
+   the first open and doubled as needed, so the table costs nothing in
+   the thread's page.  LOWEST_FREE is a hint: no descriptor below it
+   is free, so opening usually takes the hint without searching, and
+   closing just lowers it. */
+struct fd_table
+  {
+    struct fd_info **slots;     /* Open file of each fd, or NULL. */
+    struct bitmap *used;        /* Descriptors in use, including 0 and 1. */
+    int capacity;               /* Number of slots. */
+    int lowest_free;            /* No free descriptor below this. */
+  };
+
+void fd_info_init (void);
+struct fd_info *fd_info_alloc (void);
+void fd_info_free (struct fd_info *);
+
+void fd_table_init (struct fd_table *);
+void fd_table_destroy (struct fd_table *);
+int fd_table_add (struct fd_table *, struct fd_info *);
+bool fd_table_put (struct fd_table *, int fd, struct fd_info *);
+struct fd_info *fd_table_get (const struct fd_table *, int fd);
+struct fd_info *fd_table_remove (struct fd_table *, int fd);
+int fd_table_next (const struct fd_table *, int fd);
+
+#endif /* userprog/fdtable.h */
@@ -216,6 +216,65 @@ pagedir_set_accessed (uint32_t *pd, const void *vpage, bool accessed)
     }
 }
 
+/* Returns true if virtual page VPAGE is writable in PD. */
+bool
+pagedir_is_writable (uint32_t *pd, const void *vpage) 
+{
+  uint32_t *pte = lookup_page (pd, vpage, false);
+  return pte != NULL && (*pte & PTE_W) != 0;
+}
+
+/* Returns true if the PTE for virtual page VPAGE in PD is marked
+   copy-on-write. */
+bool
+pagedir_is_cow (uint32_t *pd, const void *vpage) 
+{
+  uint32_t *pte = lookup_page (pd, vpage, false);
+  return pte != NULL && (*pte & PTE_COW) != 0;
+}
+
+/* If COW is true, marks the PTE for virtual page VPAGE in PD
+   copy-on-write and makes it read-only, so that the next write
+   faults.  Otherwise makes it writable and clears the mark. */
+void
+pagedir_set_cow (uint32_t *pd, const void *vpage, bool cow) 
+{
+  uint32_t *pte = lookup_page (pd, vpage, false);
+  if (pte != NULL) 
+    {
+      if (cow)
+        *pte = (*pte & ~(uint32_t) PTE_W) | PTE_COW;
+      else
+        *pte = (*pte | PTE_W) & ~(uint32_t) PTE_COW;
+      invalidate_pagedir (pd);
+    }
+}
+
+/* Returns the lowest user virtual page at or above VPAGE that is
+   present in PD, or a null pointer if there is none.  Skips a whole
+   page table's span at a time where there is no page table. */
+void *
+pagedir_next_page (uint32_t *pd, const void *vpage) 
+{
+  uintptr_t va = (uintptr_t) pg_round_down (vpage);
+
+  while (va < (uintptr_t) PHYS_BASE) 
+    {
+      uint32_t *pde = pd + pd_no ((void *) va);
+
+      if (*pde & PTE_P) 
+        {
+          uint32_t *pt = pde_get_pt (*pde);
+          if (pt[pt_no ((void *) va)] & PTE_P)
+            return (void *) va;
+          va += PGSIZE;
+        }
+      else
+        va = (va & ~(uintptr_t) (PTSPAN - 1)) + PTSPAN;
+    }
+  return NULL;
+}
+
 /* Loads page directory PD into the CPU's page directory base
    register. */
 void
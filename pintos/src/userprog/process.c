@@ -8,6 +8,7 @@
 #include "userprog/pagedir.h"
 #include "userprog/tss.h"
 #include "userprog/process.h"
+#include "userprog/syscall.h"
 #include "filesys/directory.h"
 #include "filesys/file.h"
 #include "filesys/filesys.h"
@@ -26,7 +27,11 @@
 
 #define MAX_ARGS 25
 
+size_t stack_page_limit = STACK_PAGE_LIMIT;
+
 static thread_func start_process NO_RETURN;
+static thread_func start_fork NO_RETURN;
+static bool fork_files (struct thread *parent);
 static bool load (const char *cmdline, void (**eip) (void), void **esp);
 static char* parse_process_name (char *cmdline);
 static void parse_process_args(const char *cmdline, void **esp);
@@ -66,6 +71,121 @@ process_execute (const char *cmdline)
   return tid;
 }
 
+/* Passes a forking process's state to its child's start_fork(). */
+struct fork_info
+  {
+    struct thread *parent;      /* The process being forked. */
+    struct intr_frame if_;      /* Its user registers at the fork. */
+    struct semaphore done;      /* Upped once the child is set up. */
+    bool success;               /* Whether the child could be set up. */
+  };
+
+/* Starts a new thread running a copy of the current process, which
+   resumes in user mode from the interrupt frame IF_ but with 0 as the
+   return value of the system call.  Memory is shared copy-on-write, so
+   the parent's pages are not copied until one side writes them.
+   Returns the child's thread id, or TID_ERROR if the child could not
+   be created. */
+tid_t
+process_fork (struct intr_frame *if_)
+{
+  struct fork_info info;
+  tid_t tid;
+
+  info.parent = thread_current ();
+  info.if_ = *if_;
+  sema_init (&info.done, 0);
+  info.success = false;
+
+  tid = thread_create (info.parent->name, PRI_DEFAULT, start_fork, &info);
+  if (tid == TID_ERROR)
+    return TID_ERROR;
+
+  /* The child reads our page tables and files, so wait until it has. */
+  sema_down (&info.done);
+  return info.success ? tid : TID_ERROR;
+}
+
+/* A thread function that turns the new thread into a copy of the
+   forking process described by INFO_ and starts it running. */
+static void
+start_fork (void *info_)
+{
+  struct fork_info *info = info_;
+  struct thread *cur = thread_current ();
+  struct thread *parent = info->parent;
+  struct intr_frame if_ = info->if_;
+  bool success = false;
+
+  init_spt (cur);
+  init_mmapt ();
+  cur->stack_bottom = parent->stack_bottom;
+  cur->stack_prefault = parent->stack_prefault;
+  cur->stack_limit = parent->stack_limit;
+
+  cur->pagedir = pagedir_create ();
+  if (cur->pagedir != NULL)
+    {
+      process_activate ();
+      success = fork_spt (parent) && fork_files (parent);
+    }
+
+  /* INFO is on the parent's stack, so don't touch it after this. */
+  info->success = success;
+  sema_up (&info->done);
+  if (!success)
+    thread_exit ();
+
+  if_.eax = 0;
+  asm volatile ("movl %0, %%esp; jmp intr_exit" : : "g" (&if_) : "memory");
+  NOT_REACHED ();
+}
+
+/* Gives the current process its own handle on each file PARENT has
+   open, under the same descriptor and at the same position.  On
+   failure, closes the ones already copied and returns false. */
+static bool
+fork_files (struct thread *parent)
+{
+  struct thread *cur = thread_current ();
+  int fd;
+
+  for (fd = fd_table_next (&parent->fd_table, 0); fd != -1;
+       fd = fd_table_next (&parent->fd_table, fd + 1))
+    {
+      struct fd_info *src = fd_table_get (&parent->fd_table, fd);
+      struct fd_info *dst = fd_info_alloc ();
+
+      if (dst != NULL)
+        {
+          *dst = *src;
+          lock_acquire (&file_sys_lock);
+          dst->file = file_reopen (src->file);
+          if (dst->file != NULL)
+            file_seek (dst->file, file_tell (src->file));
+          lock_release (&file_sys_lock);
+        }
+      if (dst == NULL || dst->file == NULL
+          || !fd_table_put (&cur->fd_table, fd, dst))
+        {
+          if (dst != NULL)
+            {
+              file_close (dst->file);
+              fd_info_free (dst);
+            }
+          while ((fd = fd_table_next (&cur->fd_table, 0)) != -1)
+            {
+              dst = fd_table_remove (&cur->fd_table, fd);
+              file_close (dst->file);
+              fd_info_free (dst);
+            }
+          fd_table_destroy (&cur->fd_table);
+          return false;
+        }
+    }
+  return true;
+}
+
 /* Parses the first argument from the command line input,
    which should be the process name and returns it
 */
@@ -189,7 +309,7 @@ start_process (void *file_name_)
   struct intr_frame if_;
   bool success;
 
-  init_spt (&thread_current()->sup_page_table); // Initialize this process's Supplemental Page Table
+  init_spt (thread_current ()); // Initialize this process's Supplemental Page Table
   init_mmapt();
 
   /* Initialize interrupt frame and load executable. */
@@ -236,9 +356,7 @@ process_wait (tid_t child_tid UNUSED)
   If we get to this point...
   cp = child_process where cp->pid == B->pid
   cp->wait_called = true;
-  while (!has_exited){
-    
-  }
+  sema_down(&cp->exited);
   return cp->exit_status;
 
   */
@@ -258,9 +376,10 @@ process_wait (tid_t child_tid UNUSED)
     return -1;
   }
   cp->wait_called = true;
-  while (!cp->has_exited){
-    barrier();
-  }
+  /* Sleep until set_exit_status_of_child() ups the semaphore.  The
+     record stays on our children list, so the status can still be
+     read after the child thread is gone. */
+  sema_down(&cp->exited);
 //    cp->wait_called = false;
   //printf("Process has exited. returning status of %d\n", cp->exit_status);
   return cp->exit_status;
@@ -278,6 +397,18 @@ process_exit (void)
   pd = cur->pagedir;
   if (pd != NULL) 
     {
+      /* A process that dies without calling system_exit() (e.g. its
+         load failed) must still release a parent blocked in
+         process_wait().  Does nothing if the status is already set. */
+      set_exit_status_of_child(cur->parent, (int) cur->tid, -1);
+
+      /* Drop our frames from the frame table before their page
+         directory goes away, so neither eviction nor the aging
+         thread looks at them again.  After that nothing looks up
+         our supplemental page table either. */
+      reclaim_frames ();
+      destroy_spt (cur);
+
       /* Correct ordering here is crucial.  We must set
          cur->pagedir to NULL before switching page directories,
          so that a timer interrupt can't switch back to the
@@ -628,7 +759,14 @@ setup_stack (void **esp)
     {
       success = install_page (((uint8_t *) PHYS_BASE) - PGSIZE, kpage, true);
       if (success)
-        *esp = PHYS_BASE;
+        {
+          struct thread *t = thread_current ();
+
+          *esp = PHYS_BASE;
+          t->stack_bottom = ((uint8_t *) PHYS_BASE) - PGSIZE;
+          t->stack_prefault = 1;
+          t->stack_limit = stack_page_limit;
+        }
       else
         palloc_free_page (kpage);
     }
@@ -3,7 +3,17 @@
 
 #include "threads/thread.h"
 
+struct intr_frame;
+
+/* Default limit on the size of a process's stack, in pages (64 MB). */
+#define STACK_PAGE_LIMIT 16384
+
+/* Limit on the size of each new process's stack, in pages.
+   Set with the -sl kernel command line option. */
+extern size_t stack_page_limit;
+
 tid_t process_execute (const char *cmdline);
+tid_t process_fork (struct intr_frame *);
 int process_wait (tid_t);
 void process_exit (void);
 void process_activate (void);
@@ -1,6 +1,7 @@
 #include "userprog/syscall.h"
 #include "lib/user/syscall.h"
 #include <stdio.h>
+#include <string.h>
 #include <syscall-nr.h>
 #include "threads/interrupt.h"
 #include "threads/thread.h"
@@ -15,6 +16,9 @@
 #include "filesys/directory.h"
 #include "devices/shutdown.h"
 #include "process.h"
+#include "threads/palloc.h"
+#include "vm/frame.h"
+#include "vm/page.h"
 
 static void syscall_handler (struct intr_frame *);
 static bool is_valid_memory_access(const void *vaddr);
@@ -23,6 +27,12 @@ static bool file_already_exists (const char * file_name);
 static void get_arguments(struct intr_frame *f, int num_args, int * arguments);
 static void debug (char * debug_msg);
 static bool is_page_aligned ( void * a );
+static void *pin_user_page (const void *uaddr, bool write);
+static void unpin_user_page (void *kaddr);
+static bool copy_from_user (void *dst, const void *usrc, size_t size);
+static bool copy_to_user (void *udst, const void *src, size_t size);
+static bool copy_string_from_user (char *dst, const char *usrc, size_t size);
+static int get_user (const uint8_t *uaddr);
 
 static int system_open(int * arguments);
 static bool system_remove(int * arguments);
@@ -37,34 +47,47 @@ static void system_seek(int * arguments);
 static int mem_map(int * arguments);
 static void mem_unmap ( int * arguments );
 static int system_exec (int * arguments);
+static pid_t system_fork (struct intr_frame *f);
 
 bool debug_mode;
 
-#define WRITE_CHUNK_SIZE 300
+/* Statistics. */
+static long long syscall_cnt;   /* # of system calls. */
+static long long read_cnt;      /* # of read system calls. */
+static long long write_cnt;     /* # of write system calls. */
 
 void
 syscall_init (void) 
 {
   intr_register_int (0x30, 3, INTR_ON, syscall_handler, "syscall");
   lock_init (&file_sys_lock);
+  fd_info_init ();
   debug_mode = true;
 }
 
+/* Prints system call statistics. */
+void
+syscall_print_stats (void)
+{
+  printf ("Syscall: %lld calls, %lld reads, %lld writes\n",
+          syscall_cnt, read_cnt, write_cnt);
+}
+
 static void
 syscall_handler (struct intr_frame *f) 
 {
-  if(is_valid_memory_access((const void *) f->esp)){
-    int * num = f->esp;
-    int * system_call_arg = num + 1;
-    if (is_user_vaddr(system_call_arg) == false) {
-      // The argument to the system call is not in user space!!
-      system_exit(-1);
-    }
+  int num;
+
+  /* A page fault in the kernel doesn't save the user's stack pointer,
+     so keep it for page_fault() to check stack growth against. */
+  thread_current ()->user_esp = f->esp;
+  if(copy_from_user(&num, f->esp, sizeof num)){
     int arguments[3];
+    syscall_cnt++;
     if (debug_mode) {
-      printf("Got system call number %d\n", *num);
+      printf("Got system call number %d\n", num);
     }
-    switch(*num){
+    switch(num){
     	case SYS_HALT:
         shutdown_power_off();
     		thread_exit();
@@ -99,10 +122,12 @@ syscall_handler (struct intr_frame *f)
         f->eax = system_filesize(arguments);
       	break;
       case SYS_READ:
+        read_cnt++;
         get_arguments(f, 3, arguments);
         f->eax = system_read(arguments);
       	break;
       case SYS_WRITE:
+        write_cnt++;
         get_arguments(f, 3, arguments);
         f->eax = system_write(arguments);
       	break;
@@ -118,6 +143,9 @@ syscall_handler (struct intr_frame *f)
         get_arguments(f, 1, arguments);
         system_close(arguments);
       	break;
+      case SYS_FORK:
+        f->eax = system_fork(f);
+        break;
       case SYS_MMAP:
         get_arguments(f, 2, arguments);
         f->eax = mem_map(arguments);
@@ -148,8 +176,9 @@ system_seek(int * arguments)
 
   validate_file_descriptor(fd);
 
-  if(t->fd_array[fd] != NULL) {
-    struct file * open_file = t->fd_array[fd]->file;
+  struct fd_info * fd_information = fd_table_get (&t->fd_table, fd);
+  if(fd_information != NULL) {
+    struct file * open_file = fd_information->file;
     file_seek(open_file, position);
   } else {
         if (debug_mode) {
@@ -161,15 +190,16 @@ system_seek(int * arguments)
 
 
 
+/* Closes every file the current process has open and frees its
+   file descriptor table. */
 static void
-system_close_all(){
-  int i = 0;
+system_close_all(void){
+  int fd;
   struct thread * holder = thread_current();
-  for(i = 0; i < 18; i++){
-    if(holder->fd_array[i] != NULL){
-      system_close(&i);
-    }
+  while ((fd = fd_table_next (&holder->fd_table, 2)) != -1) {
+    system_close(&fd);
   }
+  fd_table_destroy (&holder->fd_table);
 }
 
 
@@ -185,8 +215,9 @@ bool system_remove(int * arguments) {
     int i;
     int fd = -1;
     struct thread *t = thread_current ();
-    for (i = 2; i < 18; i++) {
-      if (t->fd_array[i]->file == file) {
+    for (i = fd_table_next (&t->fd_table, 2); i != -1;
+         i = fd_table_next (&t->fd_table, i + 1)) {
+      if (fd_table_get (&t->fd_table, i)->file == file) {
         fd = i;
         break;
       }
@@ -198,7 +229,7 @@ bool system_remove(int * arguments) {
       return false; 
     }
 
-    filesys_remove(t->fd_array[fd]->file_name);    
+    filesys_remove(fd_table_get (&t->fd_table, fd)->file_name);    
     return true;
   } else {
     // the file was not passed into the system_remove
@@ -225,36 +256,57 @@ system_close(int * arguments)
 
   validate_file_descriptor(fd);
   struct thread *t = thread_current ();
-  file_close (t->fd_array[fd]->file);
-  t->fd_array[fd] = NULL;
+  struct fd_info * fd_information = fd_table_remove (&t->fd_table, fd);
+  lock_acquire (&file_sys_lock);
+  file_close (fd_information->file);
+  lock_release (&file_sys_lock);
+  fd_info_free (fd_information);
+}
+
+/*
+  System call format:
+  pid_t fork (void)
+*/
+static pid_t
+system_fork (struct intr_frame *f)
+{
+  tid_t tid = process_fork (f);
+  /* thread_create() already added the child to our children. */
+  return tid != TID_ERROR ? (pid_t) tid : -1;
 }
 
  static pid_t 
  system_exec (int * arguments)
  {
-  const base_args = ((char*)arguments[0]);
+  const char *base_args = ((char*)arguments[0]);
   // pid is mapped exactly to tid, process_execute returns tid
-  if(!is_valid_memory_access(base_args)){
-    system_exit(-1);
+  char *cmdline = palloc_get_page (0);
+  if (cmdline == NULL) {
+    return -1;
+  }
+  if (!copy_string_from_user (cmdline, base_args, PGSIZE)) {
+    palloc_free_page (cmdline);
+    return -1;
   }
   
   char buffer[100];
-  strlcpy(buffer, base_args, (strlen(base_args)+1));
+  strlcpy(buffer, cmdline, sizeof buffer);
   char *save_ptr; // Address used to keep track of tokenizer's position
   char *file_name = strtok_r(buffer, " ", &save_ptr);
 
-  if(!file_already_exists(file_name)) {
+  if(file_name == NULL || !file_already_exists(file_name)) {
         if (debug_mode) {
     printf("No file named %s exists, exiting...\n", file_name);
   }
+    palloc_free_page (cmdline);
     return -1;
   }
-  const void * args = pagedir_get_page(thread_current()->pagedir, arguments[0]);
-  pid_t pid = ((pid_t) process_execute((char *) args));
+  pid_t pid = ((pid_t) process_execute(cmdline));
+  palloc_free_page (cmdline);
   if(pid == TID_ERROR){
     return -1;
   }
-  set_child_of_thread((int) pid);
+  /* thread_create() already added pid to our children. */
   return pid;
  }
 
@@ -272,8 +324,9 @@ system_tell(int * arguments)
   
   struct thread *t = thread_current ();
   
-  if (t->fd_array[fd] != NULL) {
-    unsigned tell = ((unsigned)file_tell (t->fd_array[fd]->file));
+  struct fd_info * fd_information = fd_table_get (&t->fd_table, fd);
+  if (fd_information != NULL) {
+    unsigned tell = ((unsigned)file_tell (fd_information->file));
     return tell;
   } else {
         if (debug_mode) {
@@ -297,8 +350,9 @@ system_filesize(int * arguments)
 
   struct thread *t = thread_current ();
   
-  if (t->fd_array[fd] != NULL) {
-    int fl = ((int)file_length (t->fd_array[fd]->file));
+  struct fd_info * fd_information = fd_table_get (&t->fd_table, fd);
+  if (fd_information != NULL) {
+    int fl = ((int)file_length (fd_information->file));
     return fl;
   } else {
         if (debug_mode) {
@@ -316,16 +370,17 @@ system_filesize(int * arguments)
 */
 static int
 system_open(int * arguments){
-    char *file_name = ((char *) arguments[0]);
+    char *user_file_name = ((char *) arguments[0]);
+    char file_name[NAME_MAX + 1];
 
-if (is_valid_memory_access(file_name) == false) {
+    if (!copy_string_from_user (file_name, user_file_name, sizeof file_name)) {
           if (debug_mode) {
-      printf ("Invalid memory access at %X, exiting...\n",file_name);
+      printf("File name too long for system_open().\n");
     }
-      system_exit(-1);
+      return -1;
     }
 
-    if (file_name == NULL || strlen(file_name) == 0) {
+    if (strlen(file_name) == 0) {
           if (debug_mode) {
       printf("Empty file name string for system_open(), exiting...\n");
     }
@@ -337,20 +392,24 @@ if (is_valid_memory_access(file_name) == false) {
     struct thread *t = thread_current ();
   
     if (open_file != NULL) {
-      struct fd_info * fd_information = malloc(sizeof(struct fd_info));
-      fd_information->file = open_file;
-      fd_information->file_name = file_name;
-      int fd;
-      int i;
-      for (i = 2; i < 18; i++) {
-        if (t->fd_array[i] == NULL) {
-          fd = i;
-          break;
-        }
+      struct fd_info * fd_information = fd_info_alloc ();
+      int fd = -1;
+      if (fd_information != NULL) {
+        fd_information->file = open_file;
+        strlcpy (fd_information->file_name, file_name,
+                 sizeof fd_information->file_name);
+
+        // Take the lowest free file descriptor
+        fd = fd_table_add (&t->fd_table, fd_information);
       }
 
-      // Set the file descriptor info at the fd slot in the array
-      t->fd_array[fd] = fd_information;
+      if (fd == -1) {
+            if (debug_mode) {
+        printf ("Too many open files, could not open %s.\n", file_name);
+      }
+        file_close (open_file);
+        fd_info_free (fd_information);
+      }
    
       // Return the file descriptor
       return fd;
@@ -371,9 +430,10 @@ system_exit(int status){
   int i;
   for (i = 0; i < 16; i++) {
     if (!list_empty(&current_thread->mmap_table[i])) {
-      mem_unmap (i);
+      munmap_spt (i);
     }
   }
+  system_close_all();
   thread_exit();
 }
 
@@ -387,47 +447,56 @@ system_read(int * arguments){
   int fd = ((int) arguments[0]); 
   validate_file_descriptor(fd);
 
-  const void *buffer = ((void *) arguments[1]);
+  uint8_t *buffer = ((uint8_t *) arguments[1]);
   unsigned size = ((unsigned) arguments[2]);
+  unsigned size_read = 0;
   
   struct thread *t = thread_current ();
-  
-  if (is_valid_memory_access (buffer) == false) {
+
+  if (fd == 1) {
+    // INVALID FILE DESCRIPTOR
         if (debug_mode) {
-          printf ("Invalid memory access at %X, exiting...\n",buffer);
-          }
+    printf ("Invalid file descriptor of %d, exiting...\n",fd);
+  }
     system_exit(-1);
   }
 
-  buffer = pagedir_get_page(thread_current()->pagedir, buffer);
-
   if (fd == 0) {
     // READ FROM THE CONSOLE 
-    while (size > 0) {
-      // Read one byte at a time from the console, for a total of SIZE bytes
-      char c = ((char)input_getc());
-      void *input = &c;
-      memcpy (buffer, input, 1); 
-      size--;
+    for (size_read = 0; size_read < size; size_read++) {
+      uint8_t c = input_getc ();
+      if (!copy_to_user (buffer + size_read, &c, 1)) {
+        system_exit(-1);
+      }
     }
-
-  } else if (fd > 1 && fd < 18) {
-    // READ FROM A FILE
-      if (t->fd_array[fd] != NULL) {      
-      return file_read (t->fd_array[fd]->file, buffer, size);
-    } else {
-          if (debug_mode) {
-      printf ("File with fd=%d was not open so could not be read, exiting...\n",fd);
+    return size_read;
+  }
+
+  // READ FROM A FILE
+  /* Work one page of the buffer at a time, with just that page pinned:
+     the file system then never faults on user memory while holding
+     file_sys_lock, and a huge buffer can't pin down all of memory. */
+  while (size_read < size) {
+    const uint8_t *upage = buffer + size_read;
+    unsigned chunk = PGSIZE - pg_ofs (upage);
+    unsigned n;
+    if (chunk > size - size_read) {
+      chunk = size - size_read;
     }
-      system_exit(-1);
+
+    uint8_t *kaddr = pin_user_page (upage, true);
+    lock_acquire (&file_sys_lock);
+    n = file_read (fd_table_get (&t->fd_table, fd)->file, kaddr, chunk);
+    lock_release (&file_sys_lock);
+    unpin_user_page (kaddr);
+
+    size_read += n;
+    if (n < chunk) {
+      // End of file
+      break;
     }
-  } else {
-    // INVALID FILE DESCRIPTOR
-        if (debug_mode) {
-    printf ("Invalid file descriptor of %d, exiting...\n",fd);
-  }
-    system_exit(-1);
   }
+  return size_read;
 }
 
 
@@ -441,15 +510,10 @@ system_write(int * arguments){
   int fd = ((int) arguments[0]); 
   validate_file_descriptor(fd);
 
-  const void *buffer = ((void *) arguments[1]);
+  const uint8_t *buffer = ((uint8_t *) arguments[1]);
   unsigned size = ((unsigned) arguments[2]);
   unsigned size_written = 0;
 
-
-  if (is_valid_memory_access (buffer) == false) {
-    system_exit(-1);
-  }
-
   if (fd == 0) {
         if (debug_mode) {
     printf("File descriptor of 0 is invalid for system_write().\n");
@@ -457,30 +521,37 @@ system_write(int * arguments){
     system_exit(-1);
   }
 
-  buffer = pagedir_get_page(thread_current()->pagedir, buffer);
+  /* One page at a time, as in system_read().  Console output goes out
+     in a single putbuf() per page, so short writes aren't interleaved
+     with other processes' output. */
+  while (size_written < size) {
+    const uint8_t *upage = buffer + size_written;
+    unsigned chunk = PGSIZE - pg_ofs (upage);
+    unsigned n;
+    if (chunk > size - size_written) {
+      chunk = size - size_written;
+    }
 
-  if (fd == 1) {
-    // WRITE TO THE CONSOLE
-    if (size <= WRITE_CHUNK_SIZE) {
-      putbuf (buffer, size);
-      return size;
+    uint8_t *kaddr = pin_user_page (upage, false);
+    if (fd == 1) {
+      // WRITE TO THE CONSOLE
+      putbuf ((char *) kaddr, chunk);
+      n = chunk;
     } else {
-      // Break the write into smaller chunks
-      while (size > WRITE_CHUNK_SIZE) {
-        putbuf (buffer, size);
-        size -= WRITE_CHUNK_SIZE;
-        size_written += WRITE_CHUNK_SIZE;
-      }
-      return size_written;
+      // WRITE TO A FILE
+      lock_acquire (&file_sys_lock);
+      n = file_write (fd_table_get (&thread_current ()->fd_table, fd)->file, kaddr, chunk);
+      lock_release (&file_sys_lock);
     }
-  } else {
-    // WRITE TO A FILE
-    lock_acquire (&file_sys_lock);
-    size_written = file_write (thread_current ()->fd_array[fd]->file, buffer, size);
-    lock_release (&file_sys_lock);
+    unpin_user_page (kaddr);
 
-    return size_written;
+    size_written += n;
+    if (n < chunk) {
+      // File could not grow any further
+      break;
+    }
   }
+  return size_written;
 }
 
 
@@ -490,14 +561,14 @@ system_write(int * arguments){
 */
 static bool system_create(int * arguments){
   bool result = false;
-  const char *file_name = ((char*) arguments[0]);
+  char file_name[NAME_MAX + 1];
   const unsigned initial_size = ((unsigned) arguments[1]);
   
-  if(!is_valid_memory_access(file_name)) {
+  if (!copy_string_from_user (file_name, (char *) arguments[0], sizeof file_name)) {
         if (debug_mode) {
-    printf("Invalid system_create pointer, exiting...\n");
+    printf("File name too long for system_create().\n");
   }
-    system_exit(-1);
+    return false;
   }
 
   if (strlen(file_name) != 0) {
@@ -545,14 +616,9 @@ validate_file_descriptor(const int fd) {
     return;
   }
 
-  if (fd < 0 || fd >= 18) {
-        if (debug_mode) {
-    printf("Invalid fie descriptor of value %d.\n");
-  }
-    system_exit(-1);
-  } else if (thread_current ()->fd_array[fd] == NULL) {
+  if (fd_table_get (&thread_current ()->fd_table, fd) == NULL) {
         if (debug_mode) {
-    printf("File descriptor %d not found in the fd_array.\n", fd);
+    printf("File descriptor %d not found in the fd_table.\n", fd);
   }
     system_exit(-1);
   }
@@ -592,15 +658,181 @@ is_valid_memory_access(const void *vaddr) {
 	return true;
 }
 
+/*
+  Returns the kernel address of user address UADDR, with the frame
+  behind it pinned so that it can't be evicted until unpin_user_page().
+  A page that is not resident yet is brought in by touching it, so that
+  page_fault() loads it or grows the stack over it as it would for the
+  process itself.  Exits the process if UADDR is not
+  valid user memory, or if WRITE is true and the page is read-only.
+  If WRITE is true a copy-on-write page is copied first.
+*/
+static void *
+pin_user_page (const void *uaddr, bool write) {
+  struct thread *t = thread_current ();
+  void *kaddr;
+
+  if (uaddr == NULL || !is_user_vaddr (uaddr)) {
+    system_exit(-1);
+  }
+
+  while (true) {
+    kaddr = pagedir_get_page (t->pagedir, uaddr);
+    if (kaddr == NULL) {
+      if (get_user (uaddr) == -1) {
+        if (debug_mode) {
+          printf ("Invalid memory access at %p, exiting...\n", uaddr);
+        }
+        system_exit(-1);
+      }
+      continue;
+    }
+
+    // The kernel writes through its own mapping of the frame, which
+    // ignores the user PTE, so a read into program text would succeed.
+    if (write && !pagedir_is_writable (t->pagedir, uaddr)
+        && !pagedir_is_cow (t->pagedir, uaddr)) {
+      system_exit(-1);
+    }
+
+    // Likewise a write into a copy-on-write page would land in the frame
+    // still shared with the other process: give us our own copy first.
+    if (write && pagedir_is_cow (t->pagedir, uaddr)) {
+      if (!handle_cow_fault_spt ((void *) uaddr)) {
+        system_exit(-1);
+      }
+      continue;
+    }
+
+    // pin_frame_ft() waits out an eviction already under way, but the
+    // frame may have been evicted, and even reused, before it was
+    // pinned: then look the page up again.
+    if (pin_frame_ft (pg_round_down (kaddr))) {
+      if (pagedir_get_page (t->pagedir, uaddr) == kaddr) {
+        // Writes through KADDR don't set the user PTE's dirty bit,
+        // which is what tells a memory-mapped page to be written back.
+        if (write) {
+          pagedir_set_dirty (t->pagedir, uaddr, true);
+        }
+        return kaddr;
+      }
+      unpin_frame_ft (pg_round_down (kaddr));
+    }
+  }
+}
+
+static void
+unpin_user_page (void *kaddr) {
+  unpin_frame_ft (pg_round_down (kaddr));
+}
+
 static void
 get_arguments(struct intr_frame * f, int num_args, int * arguments){
-  int i;
-  for (i = 0; i < num_args; i++){
-    int * arg = (int *) f->esp + 1 + i;
-    arguments[i] = *arg;
+  int * args = (int *) f->esp + 1;
+  if (!copy_from_user (arguments, args, num_args * sizeof *args)) {
+    system_exit(-1);
   }
 }
 
+/*
+  User memory access.  Rather than checking a user pointer against the
+  page tables before using it, these just try the access: if it faults
+  and page_fault() can't bring the page in, page_fault() resumes at the
+  label below with eax set to -1.  (See "Accessing User Memory" in the
+  Pintos documentation.)  The range must be checked against PHYS_BASE
+  first, since kernel addresses don't fault.
+*/
+
+/* Reads a byte at user virtual address UADDR.
+   Returns the byte value if successful, -1 if a segfault occurred. */
+static int
+get_user (const uint8_t *uaddr) {
+  int result;
+  asm ("movl $1f, %0; movzbl %1, %0; 1:"
+       : "=&a" (result) : "m" (*uaddr));
+  return result;
+}
+
+/* Writes BYTE to user address UDST.
+   Returns true if successful, false if a segfault occurred. */
+static bool
+put_user (uint8_t *udst, uint8_t byte) {
+  int error_code;
+  asm ("movl $1f, %0; movb %b2, %1; 1:"
+       : "=&a" (error_code), "=m" (*udst) : "q" (byte));
+  return error_code != -1;
+}
+
+/* Returns true if [UADDR, UADDR + SIZE) lies entirely in user space. */
+static bool
+is_user_range (const void *uaddr, size_t size) {
+  return (uintptr_t) uaddr <= (uintptr_t) PHYS_BASE
+         && size <= (uintptr_t) PHYS_BASE - (uintptr_t) uaddr;
+}
+
+/* Copies SIZE bytes from user address USRC to kernel buffer DST.
+   Returns false if any of the source is not valid user memory. */
+static bool
+copy_from_user (void *dst_, const void *usrc_, size_t size) {
+  uint8_t *dst = dst_;
+  const uint8_t *usrc = usrc_;
+  size_t i;
+
+  if (!is_user_range (usrc, size)) {
+    return false;
+  }
+  for (i = 0; i < size; i++) {
+    int byte = get_user (usrc + i);
+    if (byte == -1) {
+      return false;
+    }
+    dst[i] = byte;
+  }
+  return true;
+}
+
+/* Copies SIZE bytes from kernel buffer SRC to user address UDST.
+   Returns false if any of the destination is not valid user memory. */
+static bool
+copy_to_user (void *udst_, const void *src_, size_t size) {
+  uint8_t *udst = udst_;
+  const uint8_t *src = src_;
+  size_t i;
+
+  if (!is_user_range (udst, size)) {
+    return false;
+  }
+  for (i = 0; i < size; i++) {
+    if (!put_user (udst + i, src[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/* Copies the null-terminated string at user address USRC into DST,
+   which holds SIZE bytes.  Returns false if the string doesn't fit.
+   Exits the process if the string is not valid user memory. */
+static bool
+copy_string_from_user (char *dst, const char *usrc, size_t size) {
+  size_t i;
+
+  for (i = 0; i < size; i++) {
+    int c = is_user_vaddr (usrc + i) ? get_user ((const uint8_t *) usrc + i) : -1;
+    if (c == -1) {
+      if (debug_mode) {
+        printf ("Invalid memory access at %p, exiting...\n", usrc + i);
+      }
+      system_exit(-1);
+    }
+    dst[i] = c;
+    if (c == '\0') {
+      return true;
+    }
+  }
+  return false;
+}
+
 static void
 debug (char * debug_msg) {
   if (debug_mode == true) {
@@ -625,12 +857,13 @@ mem_map ( int * arguments ){
   }
 
   // Cannot mem_map an invalid fd
-  if (t->fd_array[fd] == NULL) {
+  struct fd_info * fd_information = fd_table_get (&t->fd_table, fd);
+  if (fd_information == NULL) {
     return -1;
   }
 
   // Cannot mem_map a file with a length of zero bytes
-  int fl = ((int)file_length (t->fd_array[fd]->file));
+  int fl = ((int)file_length (fd_information->file));
   if (fl == 0) {
     return -1;
   }
@@ -675,7 +908,11 @@ mem_map ( int * arguments ){
     int address = ((int)addr);
     address += (PGSIZE * i);
     int page_num = pg_no(address);
-    mmap_spt(((void*)page_num), t->fd_array[fd]->file, i*PGSIZE, mapid);
+    if (!mmap_spt(((void*)page_num), fd_information->file, i*PGSIZE, mapid)) {
+      // Out of memory: undo the pages mapped so far.
+      munmap_spt(mapid);
+      return -1;
+    }
     page_num += PGSIZE;
   }
 
@@ -2,6 +2,7 @@
 #define USERPROG_SYSCALL_H
 
 void syscall_init (void);
+void syscall_print_stats (void);
 void print_okay (void);
 void system_exit(int status);
 
@@ -1,32 +1,98 @@
+#include "devices/timer.h"
+#include <round.h>
+#include "threads/loader.h"
+#include "threads/interrupt.h"
 #include "threads/thread.h"
 #include "threads/synch.h"
-#include "threads/malloc.h"
 #include "threads/palloc.h"
+#include "threads/slab.h"
 #include "threads/vaddr.h"
 #include "userprog/pagedir.h"
 #include "vm/frame.h"
 #include "vm/page.h"
+#include "vm/swap.h"
+
+/* Aging.  Every AGING_PERIOD ticks the aging thread samples the
+   accessed bits of the AGING_BATCH frames at the front of the frame
+   table: each frame's age is shifted right with the bit shifted in at
+   the top, the bit is cleared, and the frame moves to the back of the
+   list, so successive batches sweep the whole table.  A frame with a
+   low age hasn't been used for several sweeps and is a good victim. */
+#define AGING_PERIOD 4
+#define AGING_BATCH 32
+
+/* Age given to a new frame, as if it had just been accessed, so that
+   it isn't evicted before it has been sampled. */
+#define AGE_NEW 0x80
+
+/* Frame table entries. */
+static struct slab_cache ft_cache;
+
+/* Frame table entries indexed by physical page number, so finding a
+   frame's entry doesn't walk the list.  Allocated when the first entry
+   is added, since the frame table is initialized before the page
+   allocator. */
+static struct ft_entry **ft_index;
+
+/* Signalled, with ft_lock, whenever an eviction finishes or is called
+   off, for threads waiting on a frame being evicted. */
+static struct condition ft_evicted;
+
+static void init_entry (void *entry_);
+static void aging_thread (void *aux UNUSED);
+static void age_frames_ft (int count);
+static void * upage_of ( struct ft_entry * entry );
+static struct ft_entry * find_entry ( void * frame );
+static void set_entry ( void * frame, struct ft_entry * entry );
+static struct thread * find_sharer ( struct ft_entry * entry );
 
 void
 initialize_ft (void){
 	lock_init(&ft_lock);
-	list_init(&ft_list);
+	cond_init(&ft_evicted);
+	sized_list_init(&ft_list);
+	slab_cache_init(&ft_cache, "frame table", sizeof(struct ft_entry), init_entry);
+}
+
+/* Gives a new frame table entry the state of a frame just mapped by
+   the thread that owns it. */
+static void
+init_entry (void *entry_){
+	struct ft_entry *entry = entry_;
+	entry->pin_cnt = 0;
+	entry->age = AGE_NEW;
+	entry->sharers = 1;
+	entry->evictable = true;
+	entry->evicting = false;
 }
 
+/* Allocates a frame for the user page at VADDR, evicting another if
+   memory is full, and maps it in the current thread's page directory.
+   If PINNED is true the frame starts out pinned, so that the caller can
+   fill it before anyone can evict it, and must unpin it afterward.
+   Returns the frame's kernel address, or a null pointer on failure. */
 void *
-allocate_frame_ft (void * vaddr) {
+allocate_frame_ft (void * vaddr, bool pinned) {
 
   // (1) Allocate the new frame
   void * new_frame = palloc_get_page (PAL_USER | PAL_ZERO);
   while ( new_frame == NULL ){
   	// Must perform an eviction
   	void * evict = get_frame_to_evict();
+  	struct thread * owner;
+  	void * page;
   	if (evict == NULL){
   		// Could not get a frame to evict.
   		return NULL;
    	}
+  	if (!get_owner_ft (evict, &owner, &page)){
+  		release_frame_ft (evict);
+  		return NULL;
+  	}
 
-  	if ( swap_frame_out_st ( evict ) ) {
+  	// Memory-mapped pages go back to their file (only if dirty),
+  	// everything else goes to swap.
+  	if ( evict_mmap_page_spt ( owner, page ) || swap_frame_out_st ( evict, owner, page ) ) {
 
   		// Swap succeeded, continue
 
@@ -35,18 +101,24 @@ allocate_frame_ft (void * vaddr) {
 
   	} else {
 
-  		// Swap didn't succeed.
-  		// Due to a kernel panic, we should never reach this.
-  		// But just in case, I fail gracefully! :D
+  		// Swap didn't succeed: the owner has no page table entry
+  		// for the page, so leave the frame alone and fail.
+  		release_frame_ft ( evict );
   		return NULL;
 
   	}
 
 
   }
-  add_entry_ft (new_frame, pg_no(vaddr));
+  if (!add_entry_ft (new_frame, pg_no(vaddr), pinned)) {
+
+    palloc_free_page (new_frame);
+    return NULL;
+
+  }
   if (!install_page (pg_round_down(vaddr), new_frame, true)) {
 
+    remove_entry_ft (new_frame);
     palloc_free_page (new_frame);
    	return NULL;
 
@@ -55,106 +127,360 @@ allocate_frame_ft (void * vaddr) {
 
 }
 
-void
-add_entry_ft (void * frame, void * page){
-	struct ft_entry *entry = malloc(sizeof(struct ft_entry));
+/* Adds FRAME, holding PAGE of the current thread, to the frame table,
+   pinned if PINNED is true.  Returns false if out of memory. */
+bool
+add_entry_ft (void * frame, void * page, bool pinned){
+	struct ft_entry *entry = slab_alloc(&ft_cache);
+	if(entry == NULL){
+		return false;
+	}
 	lock_acquire(&ft_lock);
 	entry->frame_number = frame;
+	entry->pin_cnt = pinned ? 1 : 0;
 	entry->page_number = page;
 	entry->t = thread_current();
-	list_push_back(&ft_list, &entry->elem);
+	sized_list_push_back(&ft_list, &entry->elem);
+	set_entry(frame, entry);
 	lock_release(&ft_lock);
+	return true;
 }
 
 void
 remove_entry_ft (void * frame){
-	struct list_elem *e;
 	struct ft_entry *entry;
 	lock_acquire(&ft_lock);
 
-	for (e = list_begin (&ft_list); e != list_end (&ft_list); e = list_next (e)) {
-	  	entry = list_entry (e, struct ft_entry, elem);
-	  	if(entry->frame_number == frame){
-	  		list_remove(&entry->elem); //used to be (&ft_list->elem)
-	  		break;
-	  	}
-  	}
+	entry = find_entry (frame);
+	if(entry != NULL){
+		sized_list_remove(&ft_list, &entry->elem);
+		set_entry(frame, NULL);
+		if(entry->evicting){
+			cond_broadcast(&ft_evicted, &ft_lock);
+		}
+	}
   	lock_release(&ft_lock);
-  	free(entry);
+  	slab_free(&ft_cache, entry);
 }
 
 void *
 get_entry_ft (void * frame){
-	struct list_elem *e;
 	struct ft_entry *entry;
+	void *page;
 	lock_acquire(&ft_lock);
+	entry = find_entry (frame);
+	page = entry != NULL ? entry->page_number : NULL;
+  	lock_release(&ft_lock);
+  	return page;
+}
 
-	for (e = list_begin (&ft_list); e != list_end (&ft_list); e = list_next (e)) {
-	  	entry = list_entry (e, struct ft_entry, elem);
-	  	if(entry->frame_number == frame){
-	  		lock_release(&ft_lock);
-	  		return entry->page_number;
-	  	}
-  	}
+/* Stores the thread that owns FRAME in *OWNER and the page number it
+   holds in *PAGE.  Returns false if FRAME is not in the frame table. */
+bool
+get_owner_ft (void * frame, struct thread ** owner, void ** page){
+	struct ft_entry *entry;
+	lock_acquire(&ft_lock);
+	entry = find_entry (frame);
+	if(entry != NULL){
+		*owner = entry->t;
+		*page = entry->page_number;
+	}
   	lock_release(&ft_lock);
-  	return NULL;
+  	return entry != NULL;
 }
 
+/* Pins FRAME, so get_frame_to_evict() passes it over while the kernel
+   is accessing it on behalf of a user process.  Pins are counted, since
+   a frame shared after a fork can be pinned by each process mapping it,
+   and each must be dropped with unpin_frame_ft().  If FRAME is
+   being evicted, waits for the eviction to finish or be called off.
+   Returns false if FRAME is no longer in the frame table by then, in
+   which case the caller must look its page up again. */
+bool
+pin_frame_ft (void * frame){
+	struct ft_entry *entry;
+	lock_acquire(&ft_lock);
+	entry = find_entry (frame);
+	while(entry != NULL && entry->evicting){
+		cond_wait(&ft_evicted, &ft_lock);
+		entry = find_entry (frame);
+	}
+	if(entry != NULL){
+		entry->pin_cnt++;
+	}
+  	lock_release(&ft_lock);
+  	return entry != NULL;
+}
+
+/* Drops a pin taken on FRAME; it can be evicted again once the last is
+   gone. */
+void
+unpin_frame_ft (void * frame){
+	struct ft_entry *entry;
+	lock_acquire(&ft_lock);
+	entry = find_entry (frame);
+	if(entry != NULL){
+		ASSERT (entry->pin_cnt > 0);
+		entry->pin_cnt--;
+	}
+  	lock_release(&ft_lock);
+}
 
+/* Picks the unpinned frame that has gone unused the longest, going by
+   the ages kept by the aging thread.  Among frames of the same age a
+   clean one is preferred, since it is cheaper to evict.  The victim is
+   claimed before ft_lock is released, so it can't be pinned or picked
+   again while the caller evicts it; the caller must finish with
+   remove_entry_ft() or call it off with release_frame_ft(). */
 void *
 get_frame_to_evict (void){
 	struct list_elem *e;
+	struct ft_entry * victim = NULL;
+	bool victim_dirty = false;
 
 	lock_acquire(&ft_lock);
 
-	struct ft_entry * entries[4];
-	int i;
-	for (i = 0; i < 4; i++){
-		entries[i] = NULL;
-	}
-
-	for (e = list_begin (&ft_list); e != list_end (&ft_list); e = list_next (e)) {
+	for (e = list_begin (&ft_list.list); e != list_end (&ft_list.list); e = list_next (e)) {
 	  	struct ft_entry *entry = list_entry (e, struct ft_entry, elem);
-	  	bool accessed = pagedir_is_accessed(entry->t->pagedir, entry->page_number);
-	  	bool dirty = pagedir_is_dirty(entry->t->pagedir, entry->page_number);
-	  	if(accessed && dirty){
-	  		entries[3] = entry;
-	  	}
-	  	if(accessed && !dirty){
-	  		entries[2] = entry;
+	  	if(entry->pin_cnt > 0 || entry->evicting || entry->sharers > 1
+	  	   || !entry->evictable || entry->t == NULL){
+	  		continue;
 	  	}
-	  	if(!accessed && dirty){
-	  		entries[1] = entry;
-	  	}
-	  	if(!accessed && !dirty){
-	  		entries[0] = entry;
+	  	bool dirty = pagedir_is_dirty(entry->t->pagedir, upage_of (entry));
+	  	if(victim == NULL || entry->age < victim->age
+	  	   || (entry->age == victim->age && victim_dirty && !dirty)){
+	  		victim = entry;
+	  		victim_dirty = dirty;
 	  	}
+  	}
 
+  	if(victim != NULL){
+  		victim->evicting = true;
   	}
+  	lock_release(&ft_lock);
+  	return victim != NULL ? victim->frame_number : NULL;
+}
 
-  	for (i = 0; i < 4; i++){
-  		if(entries[i] != NULL){
-  			lock_release(&ft_lock);
-  			return entries[i]->frame_number;
-  		}
+/* Calls off the eviction of FRAME, claimed by get_frame_to_evict(). */
+void
+release_frame_ft (void * frame){
+	struct ft_entry *entry;
+	lock_acquire(&ft_lock);
+	entry = find_entry (frame);
+	if(entry != NULL){
+		entry->evicting = false;
 	}
+	cond_broadcast(&ft_evicted, &ft_lock);
   	lock_release(&ft_lock);
-  	return NULL;
+}
+
+/* Starts the thread that keeps the frames' ages up to date. */
+void
+start_aging_ft (void){
+	thread_create ("aging", PRI_DEFAULT, aging_thread, NULL);
+}
+
+/* Ages a batch of frames every AGING_PERIOD ticks, forever. */
+static void
+aging_thread (void *aux UNUSED){
+	for (;;) {
+		timer_sleep (AGING_PERIOD);
+		age_frames_ft (AGING_BATCH);
+	}
+}
+
+/* Ages up to COUNT frames from the front of the frame table and moves
+   them to the back. */
+static void
+age_frames_ft (int count){
+	lock_acquire(&ft_lock);
 
+	if (count > (int) sized_list_size (&ft_list)) {
+		count = sized_list_size (&ft_list);
+	}
+	while (count-- > 0) {
+	  	struct ft_entry *entry = list_entry (sized_list_pop_front (&ft_list),
+	  	                                     struct ft_entry, elem);
+	  	uint32_t *pd = entry->t != NULL ? entry->t->pagedir : NULL;
+	  	void *upage = upage_of (entry);
+	  	bool accessed = pd != NULL && pagedir_is_accessed (pd, upage);
+
+	  	entry->age = (entry->age >> 1) | (accessed ? AGE_NEW : 0);
+	  	if (accessed) {
+	  		pagedir_set_accessed (pd, upage, false);
+	  	}
+	  	sized_list_push_back (&ft_list, &entry->elem);
+  	}
+
+  	lock_release(&ft_lock);
+}
 
+/* Returns the user virtual address of the page held in ENTRY's frame. */
+static void *
+upage_of ( struct ft_entry * entry ){
+	return (void *) ((uintptr_t) entry->page_number << PGBITS);
 }
 
+/* Drops the current thread's frames from the frame table, before its
+   page directory is destroyed.  Frames still shared with another
+   process are taken out of the page directory instead, so that
+   pagedir_destroy() doesn't free them. */
 void
 reclaim_frames(void){
-	struct list_elem *e;
+	struct list_elem *e, *next;
 	lock_acquire(&ft_lock);
 	struct thread * ct = thread_current();
-	for (e = list_begin (&ft_list); e != list_end (&ft_list); e = list_next (e)) {
+	for (e = list_begin (&ft_list.list); e != list_end (&ft_list.list); e = next) {
 	  	struct ft_entry *entry = list_entry (e, struct ft_entry, elem);
-	  	if(entry->t == ct){
-	  		list_remove(&entry->elem);
-  		  	free(entry);
+	  	next = list_next (e);
+	  	if(entry->evicting && entry->t == ct){
+	  		// Another thread is writing the frame out and will clear it
+	  		// from our page directory, so wait for it, then start over.
+	  		cond_wait(&ft_evicted, &ft_lock);
+	  		next = list_begin (&ft_list.list);
+	  	} else if(entry->sharers > 1 && ct->pagedir != NULL
+	  	   && pagedir_get_page (ct->pagedir, upage_of (entry)) == entry->frame_number){
+	  		pagedir_clear_page (ct->pagedir, upage_of (entry));
+	  		entry->sharers--;
+	  		if(entry->t == ct){
+	  			entry->t = find_sharer (entry);
+	  		}
+	  	} else if(entry->t == ct){
+	  		sized_list_remove(&ft_list, &entry->elem);
+	  		set_entry(entry->frame_number, NULL);
+  		  	slab_free(&ft_cache, entry);
 	  	}
   	}
   	lock_release(&ft_lock);
+}
+
+/* Records that one more page directory maps the frame holding user page
+   UPAGE of OWNER, for fork, and stores the frame in *FRAME.  The page is
+   looked up under ft_lock, waiting out an eviction under way, so the
+   frame can't be evicted between the lookup and the share; if the page
+   is not resident *FRAME is set to NULL.  A frame the table doesn't
+   track yet, such as one loaded from the executable, is added with
+   OWNER but kept out of eviction, since nothing would bring it back
+   from swap.  Returns false if out of memory. */
+bool
+share_frame_ft (struct thread * owner, void * upage, void ** frame){
+	struct ft_entry *entry;
+	lock_acquire(&ft_lock);
+
+	*frame = pagedir_get_page(owner->pagedir, upage);
+	entry = find_entry (*frame);
+	while(entry != NULL && entry->evicting){
+		cond_wait(&ft_evicted, &ft_lock);
+		*frame = pagedir_get_page(owner->pagedir, upage);
+		entry = find_entry (*frame);
+	}
+	if(*frame == NULL){
+		lock_release(&ft_lock);
+		return true;
+	}
+	if(entry == NULL){
+		entry = slab_alloc(&ft_cache);
+		if(entry == NULL){
+			lock_release(&ft_lock);
+			return false;
+		}
+		entry->frame_number = *frame;
+		entry->page_number = (void *) pg_no (upage);
+		entry->t = owner;
+		entry->evictable = false;
+		sized_list_push_back(&ft_list, &entry->elem);
+		set_entry(*frame, entry);
+	}
+	entry->sharers++;
+
+	lock_release(&ft_lock);
+	return true;
+}
+
+/* Drops the current thread's share of FRAME, which it has already
+   taken out of its page directory.  If the thread owned the entry,
+   ownership passes to another thread still mapping the frame.  The
+   frame is freed once nobody maps it. */
+void
+unshare_frame_ft (void * frame){
+	struct ft_entry *entry;
+	lock_acquire(&ft_lock);
+
+	entry = find_entry (frame);
+	if(entry != NULL){
+		if(--entry->sharers == 0){
+			sized_list_remove(&ft_list, &entry->elem);
+			set_entry(frame, NULL);
+			slab_free(&ft_cache, entry);
+			palloc_free_page(frame);
+		} else if(entry->t == thread_current()){
+			entry->t = find_sharer (entry);
+		}
+	}
+
+	lock_release(&ft_lock);
+}
+
+/* Returns true if more than one page directory maps FRAME. */
+bool
+is_shared_frame_ft (void * frame){
+	struct ft_entry *entry;
+	bool shared;
+	lock_acquire(&ft_lock);
+	entry = find_entry (frame);
+	shared = entry != NULL && entry->sharers > 1;
+	lock_release(&ft_lock);
+	return shared;
+}
+
+/* Returns the frame table entry for FRAME, or NULL if there is none.
+   The caller must hold ft_lock. */
+static struct ft_entry *
+find_entry ( void * frame ){
+	if(ft_index == NULL || frame == NULL){
+		return NULL;
+	}
+	return ft_index[vtop (frame) >> PGBITS];
+}
+
+/* Makes ENTRY, which may be NULL, the entry found for FRAME.  The
+   caller must hold ft_lock. */
+static void
+set_entry ( void * frame, struct ft_entry * entry ){
+	if(ft_index == NULL){
+		size_t pages = DIV_ROUND_UP (init_ram_pages * sizeof *ft_index, PGSIZE);
+		ft_index = palloc_get_multiple (PAL_ASSERT | PAL_ZERO, pages);
+	}
+	ft_index[vtop (frame) >> PGBITS] = entry;
+}
+
+/* Used by find_sharer() to look for a thread mapping a frame. */
+struct sharer_search {
+	struct ft_entry *entry;
+	struct thread *found;
+};
+
+static void
+check_sharer (struct thread *t, void *aux){
+	struct sharer_search *s = aux;
+	if(s->found == NULL && t->pagedir != NULL
+	   && pagedir_get_page (t->pagedir, upage_of (s->entry)) == s->entry->frame_number){
+		s->found = t;
+	}
+}
+
+/* Returns a thread whose page directory maps ENTRY's frame at ENTRY's
+   page, or NULL if there is none right now.  Forked processes share
+   frames at the same user address, so the page is the same for all. */
+static struct thread *
+find_sharer ( struct ft_entry * entry ){
+	struct sharer_search s;
+	enum intr_level old_level;
+
+	s.entry = entry;
+	s.found = NULL;
+	old_level = intr_disable ();
+	thread_foreach (check_sharer, &s);
+	intr_set_level (old_level);
+	return s.found;
 }
\ No newline at end of file
@@ -1,26 +1,43 @@
 #ifndef VM_FRAME_H_
 #define VM_FRAME_H_
 
+#include <stdbool.h>
+#include <stdint.h>
 #include "threads/synch.h"
 
-struct list ft_list;
+struct thread;
+
+struct sized_list ft_list;
 
 struct ft_entry {
 	void * frame_number;
 	void * page_number;
 	struct thread * t;
+	unsigned pin_cnt; /* Pins held by the kernel; not evicted unless 0. */
+	uint8_t age; /* Recent accessed bits, newest in the top bit. */
+	int sharers; /* Page directories mapping the frame, more than 1 after a fork. */
+	bool evictable; /* False for frames that have no way back from swap. */
+	bool evicting; /* Claimed by get_frame_to_evict(), on its way out. */
 	struct list_elem elem;
 };
 
 struct lock ft_lock;
 
 void initialize_ft ( void );
-void add_entry_ft ( void * frame, void * page );
+bool add_entry_ft ( void * frame, void * page, bool pinned );
 void remove_entry_ft ( void * frame );
 void * get_entry_ft ( void * frame );
+bool get_owner_ft ( void * frame, struct thread ** owner, void ** page );
 void * get_frame_to_evict ( void );
+void release_frame_ft ( void * frame );
 void reclaim_frames ( void );
-void * allocate_frame_ft ( void * vaddr );
+void * allocate_frame_ft ( void * vaddr, bool pinned );
+bool pin_frame_ft ( void * frame );
+void unpin_frame_ft ( void * frame );
+void start_aging_ft ( void );
+bool share_frame_ft ( struct thread * owner, void * upage, void ** frame );
+void unshare_frame_ft ( void * frame );
+bool is_shared_frame_ft ( void * frame );
 
 
 #endif
\ No newline at end of file
@@ -1,27 +1,165 @@
 #include "vm/page.h"
 #include "threads/synch.h"
 #include "threads/thread.h"
-#include "threads/malloc.h"
 #include "threads/palloc.h"
+#include "threads/slab.h"
 #include "userprog/pagedir.h"
 #include "filesys/file.h"
+#include "threads/pte.h"
 #include "threads/vaddr.h"
 #include "userprog/process.h"
 #include "vm/frame.h"
 #include "vm/mmap.h"
 #include "userprog/syscall.h"
+#include "vm/swap.h"
+#include <string.h>
 
 
+/* The supplemental page table mirrors the x86 page directory: a
+   directory page holds 1024 pointers to table pages, and each table
+   page holds 1024 pointers to entries.  The upper 10 bits of a page
+   number index the directory and the lower 10 the table, so a lookup
+   is two array indexes, and neighbouring pages have neighbouring
+   slots.  Pages are allocated on first use: the directory when the
+   first entry is added, and a table when the first entry in its 4 MB
+   of address space is. */
+#define SPT_CNT (1 << PTBITS)           /* Slots in a directory or table page. */
+
 // Static method declarations:
-static unsigned spt_entry_hash (const struct hash_elem *spte_, void *aux UNUSED);
-static bool spt_entry_less (const struct hash_elem *a_, const struct hash_elem *b_, void *aux UNUSED);
 static bool allocate_new_frame(struct spt_entry *spte);
+static struct spt_entry *lookup_spt (struct thread *t, const void *page_num);
+static struct spt_entry **find_slot_spt (struct thread *t, const void *page_num, bool create);
+static bool insert_spt (struct thread *t, struct spt_entry *spte);
+static struct spt_entry *next_entry_spt (struct thread *t, const void *page_num);
+static void *unmap_mmap_page (struct thread *t, struct spt_entry *spte);
+static struct spt_entry *copy_entry_spt (const struct spt_entry *src);
+static void init_entry (void *spte_);
+
+/* Supplemental page table entries. */
+static struct slab_cache spt_cache;
+
+/* Initializes the cache that supplemental page table entries are
+   allocated from. */
+void
+initialize_spt (void) {
+  slab_cache_init (&spt_cache, "supplemental page table",
+                   sizeof (struct spt_entry), init_entry);
+}
+
+/* Gives a new entry the state of an anonymous page that is neither
+   mapped nor swapped out. */
+static void
+init_entry (void *spte_) {
+  struct spt_entry *spte = spte_;
+  spte->frame_num = NULL;
+  spte->sector_num = -1;
+  spte->file_offset = 0;
+  spte->file = NULL;
+  spte->mapid = -1;
+  spte->in_swap = false;
+}
 
+/* Initialize the supplemental page table of T.  Allocates nothing
+   until the first entry is added. */
+void
+init_spt (struct thread *t) {
+  t->sup_page_table = NULL;
+}
 
-/* Initialize the supplemental page table. */
+/* Frees every entry in T's supplemental page table, and the table
+   itself.  Walks each table page in order and skips the 4 MB regions
+   that never had one. */
 void
-init_spt (struct hash * h) {
-	hash_init (h, spt_entry_hash, spt_entry_less, NULL);
+destroy_spt (struct thread *t) {
+  struct spt_entry ***dir = t->sup_page_table;
+  size_t i, j;
+
+  if (dir == NULL) {
+    return;
+  }
+  for (i = 0; i < SPT_CNT; i++) {
+    struct spt_entry **table = dir[i];
+    if (table == NULL) {
+      continue;
+    }
+    for (j = 0; j < SPT_CNT; j++) {
+      slab_free (&spt_cache, table[j]);
+    }
+    palloc_free_page (table);
+  }
+  palloc_free_page (dir);
+  t->sup_page_table = NULL;
+}
+
+/* Returns the slot for PAGE_NUM in T's supplemental page table.  If
+   the directory or table page it would be in doesn't exist yet,
+   allocates it if CREATE is true and returns a null pointer
+   otherwise, or if out of memory. */
+static struct spt_entry **
+find_slot_spt (struct thread *t, const void *page_num, bool create) {
+  uintptr_t pn = (uintptr_t) page_num;
+  size_t dir_idx = pn >> PTBITS;
+  struct spt_entry **table;
+
+  if (dir_idx >= SPT_CNT) {
+    return NULL;
+  }
+  if (t->sup_page_table == NULL) {
+    if (!create) {
+      return NULL;
+    }
+    t->sup_page_table = palloc_get_page (PAL_ZERO);
+    if (t->sup_page_table == NULL) {
+      return NULL;
+    }
+  }
+  table = t->sup_page_table[dir_idx];
+  if (table == NULL) {
+    if (!create) {
+      return NULL;
+    }
+    table = t->sup_page_table[dir_idx] = palloc_get_page (PAL_ZERO);
+    if (table == NULL) {
+      return NULL;
+    }
+  }
+  return &table[pn & (SPT_CNT - 1)];
+}
+
+/* Adds SPTE to T's supplemental page table under its page number.
+   Returns FALSE if the page already has an entry or memory runs
+   out. */
+static bool
+insert_spt (struct thread *t, struct spt_entry *spte) {
+  struct spt_entry **slot = find_slot_spt (t, spte->page_num, true);
+
+  if (slot == NULL || *slot != NULL) {
+    return false;
+  }
+  *slot = spte;
+  return true;
+}
+
+/* Returns the entry in T's supplemental page table with the lowest
+   page number that is at least PAGE_NUM, or a null pointer if there
+   is none.  Used to walk the table in address order. */
+static struct spt_entry *
+next_entry_spt (struct thread *t, const void *page_num) {
+  uintptr_t pn = (uintptr_t) page_num;
+  struct spt_entry ***dir = t->sup_page_table;
+
+  if (dir == NULL) {
+    return NULL;
+  }
+  for (; (pn >> PTBITS) < SPT_CNT; pn++) {
+    struct spt_entry **table = dir[pn >> PTBITS];
+    if (table == NULL) {
+      pn |= SPT_CNT - 1;
+    } else if (table[pn & (SPT_CNT - 1)] != NULL) {
+      return table[pn & (SPT_CNT - 1)];
+    }
+  }
+  return NULL;
 }
 
 /* Called by the page fault handler in exception.c. Passes responsibility
@@ -33,12 +171,16 @@ bool handle_page_fault_spt(struct spt_entry * spte) {
   } else if (spte->mapid != -1){
     // MEMORY MAPPED FILE
     uint32_t vaddr = ((uint32_t) spte->page_num) << 12; // This is a potential source of error
-    uint32_t *kpage = allocate_frame_ft(vaddr);                                           
+    // The frame comes pinned, so it can't be evicted half read.
+    uint32_t *kpage = allocate_frame_ft(vaddr, true);
     if (kpage != NULL) {
-      spte->frame_num = kpage;      
-      // Actually write from the file to the memory frame:    
-      file_read_at (spte->file, vaddr, PGSIZE, spte->file_offset);       
-
+      spte->frame_num = (void *) pg_no (kpage);
+      // Read the file straight into the frame through its kernel address,
+      // so the user mapping stays clean until the process writes to it.
+      lock_acquire (&file_sys_lock);
+      file_read_at (spte->file, kpage, PGSIZE, spte->file_offset);
+      lock_release (&file_sys_lock);
+      unpin_frame_ft (kpage);
     } else {
       return false;
     }
@@ -46,94 +188,270 @@ bool handle_page_fault_spt(struct spt_entry * spte) {
   }
 }
 
-/* Returns a hash value for supplemental page table entry spte. */
-static unsigned
-spt_entry_hash (const struct hash_elem *el, void *aux UNUSED)
-{
-  struct spt_entry *entry = hash_entry (el, struct spt_entry, hash_elem);
-  return hash_int ((int) entry->page_num);
-}
-
-
-/* Returns true if supplemental page table entry a precedes supplemental page table entry b. */
-static bool
-spt_entry_less (const struct hash_elem *a, const struct hash_elem *b,
-           void *aux UNUSED)
-{
-  struct spt_entry *my_a = hash_entry (a, struct spt_entry, hash_elem);
-  struct spt_entry *my_b = hash_entry (b, struct spt_entry, hash_elem);
-
-  return my_a->page_num < my_b->page_num;
-}
-
-
 /* Add an entry for mem_map to the supplemental page table for use with 
-   memory mapping. */
-void 
+   memory mapping. Returns FALSE if memory runs out or the page already
+   has an entry. */
+bool
 mmap_spt(void *page_num, struct file *f, int file_offset, mapid_t mapid) {
-	struct spt_entry *spte = malloc(sizeof(struct spt_entry));
-	spte->file = f;
+	struct spt_entry *spte = slab_alloc(&spt_cache);
+  if (spte == NULL) {
+    return false;
+  }
+	spte->file = file_reopen (f); // Our own reference, so the mapping persists through a file_close
 	spte->page_num = page_num;
   spte->mapid = mapid;
-  spte->in_swap = false;
   spte->file_offset = file_offset;
 
+  if (spte->file == NULL || !insert_spt (thread_current (), spte)) {
+    file_close (spte->file);
+    slab_free (&spt_cache, spte);
+    return false;
+  }
   add_entry_mmapt(mapid, spte);
-  file_reopen(spte->file); // Need to increment the reference count to the file so that it persists through a file_close
-	hash_insert (&thread_current()->sup_page_table, &spte->hash_elem);
+  return true;
 }
 
 /* Removes all entries with given mapid, for use with memory unmapping. */
 void
 munmap_spt(mapid_t mapid) {
-  printf("mapid %i=\n",mapid);
-
   // (1) Get the list of spt_entry's from the Mapid Table
   struct list *spt_list = get_entries_mmapt(mapid);
-  struct list_elem *e;
-  for (e = list_begin (spt_list); e != list_end (spt_list);
-       e = list_next (e))
+  while (!list_empty (spt_list))
     {
+      struct spt_entry *spte = list_entry (list_pop_front (spt_list),
+                                           struct spt_entry, list_elem);
 
-      struct spt_entry *spte = list_entry (e, struct spt_entry, list_elem);
-      void * page = spte->page_num;             // This bitshifting to create a physical
-      uint32_t vaddr = ((uint32_t) page) << 12; // address is a potential source of error
+      // (a) Write back the page if it is resident and was written to,
+      //     then give its frame back.
+      void *kpage = unmap_mmap_page (thread_current (), spte);
+      if (kpage != NULL) {
+        remove_entry_ft (kpage);
+        palloc_free_page (kpage);
+      }
 
-      // (a) Write back the pages for every entry
+      // (b) Remove the entry from the Supplemental Page Table
       lock_acquire (&file_sys_lock);
-      file_write_at (spte->file, ((void*)vaddr), PGSIZE, spte->file_offset);
+      file_close (spte->file);
       lock_release (&file_sys_lock);
+      remove_entry_spt (spte->page_num);
+    }
 
+  // (2) Remove the entry from the Mapid Table
+  remove_entry_mmapt (mapid);
+}
 
-      // (b) Remove the entry from the Supplemental Page Table
-      remove_entry_spt (page);
+/* Called when the frame holding page PAGE_NUM of thread T is chosen for
+   eviction.  A memory-mapped page doesn't need a swap slot: it is written
+   back to its file if T dirtied it and just dropped otherwise, to be read
+   in again on the next fault.  Returns FALSE if the page is not memory
+   mapped, in which case the caller must swap it out instead. */
+bool
+evict_mmap_page_spt (struct thread *t, const void *page_num) {
+  struct spt_entry *spte = lookup_spt (t, page_num);
 
+  if (spte == NULL || spte->mapid == -1) {
+    return false;
+  }
+  unmap_mmap_page (t, spte);
+  return true;
+}
+
+/* Removes memory-mapped page SPTE from T's page directory, then writes
+   it back to its file if the dirty bit is set.  The mapping is cleared
+   before the dirty bit is read, so the process can't dirty the page
+   again between the two; clearing only drops PTE_P, so the bit is still
+   there to read.
+   Returns the kernel address of the frame that held the page, or a null
+   pointer if the page was not resident. */
+static void *
+unmap_mmap_page (struct thread *t, struct spt_entry *spte) {
+  void *upage = (void *) (((uint32_t) spte->page_num) << 12);
+  void *kpage = pagedir_get_page (t->pagedir, upage);
+  bool dirty;
+
+  if (kpage == NULL) {
+    return NULL;
+  }
+  pagedir_clear_page (t->pagedir, upage);
+  dirty = pagedir_is_dirty (t->pagedir, upage);
+  if (dirty) {
+    lock_acquire (&file_sys_lock);
+    file_write_at (spte->file, kpage, PGSIZE, spte->file_offset);
+    lock_release (&file_sys_lock);
+  }
+  return kpage;
+}
+
+/* Gives the current process, a child being forked from PARENT, a copy
+   of PARENT's user memory.  Resident pages are shared: both page
+   directories map the same frames, and writable pages become read-only
+   copy-on-write pages in both, copied by handle_cow_fault_spt() on the
+   first write.  Pages PARENT has swapped out are read into frames of
+   our own right away.  Memory mappings are not inherited.  Returns
+   FALSE if memory runs out. */
+bool
+fork_spt (struct thread *parent) {
+  struct thread *cur = thread_current ();
+  struct spt_entry *pe;
+  uint8_t *upage;
+
+  for (upage = pagedir_next_page (parent->pagedir, (void *) PGSIZE);
+       upage != NULL;
+       upage = pagedir_next_page (parent->pagedir, upage + PGSIZE)) {
+    struct spt_entry *spte = lookup_spt (parent, (void *) pg_no (upage));
+    void *kpage;
+    bool writable = pagedir_is_writable (parent->pagedir, upage)
+                    || pagedir_is_cow (parent->pagedir, upage);
+
+    if (spte != NULL && spte->mapid != -1) {
+      continue;
+    }
+    // The frame is looked up and shared in one step, so it can't be
+    // evicted in between.  A page evicted before that is in swap by
+    // now and is copied by the loop below.
+    if (!share_frame_ft (parent, upage, &kpage)) {
+      return false;
+    }
+    if (kpage == NULL) {
+      continue;
+    }
+    if (spte != NULL && copy_entry_spt (spte) == NULL) {
+      unshare_frame_ft (kpage);
+      return false;
+    }
+    if (!pagedir_set_page (cur->pagedir, upage, kpage, false)) {
+      unshare_frame_ft (kpage);
+      return false;
+    }
+    if (writable) {
+      pagedir_set_cow (parent->pagedir, upage, true);
+      pagedir_set_cow (cur->pagedir, upage, true);
     }
+  }
 
-  // (2) Remove the entry from the Mapid Table
-  remove_entry_mmapt (mapid);
+  for (pe = next_entry_spt (parent, 0); pe != NULL;
+       pe = next_entry_spt (parent, (uint8_t *) pe->page_num + 1)) {
+    struct spt_entry *ce;
+    void *kpage;
+
+    if (!pe->in_swap || pe->mapid != -1) {
+      continue;
+    }
+    ce = copy_entry_spt (pe);
+    if (ce == NULL) {
+      return false;
+    }
+    kpage = allocate_frame_ft ((void *) (((uint32_t) pe->page_num) << 12), true);
+    if (kpage == NULL) {
+      return false;
+    }
+    swap_read_st (pe->sector_num, kpage);
+    unpin_frame_ft (kpage);
+    ce->in_swap = false;
+    ce->sector_num = -1;
+    ce->frame_num = (void *) pg_no (kpage);
+  }
+  return true;
+}
+
+/* Called by the page fault handler on a write to a copy-on-write page.
+   If the frame is still shared, the page gets a private copy;
+   otherwise it is just made writable again.  Returns FALSE if memory
+   runs out. */
+bool
+handle_cow_fault_spt (void *fault_addr) {
+  struct thread *cur = thread_current ();
+  void *upage = pg_round_down (fault_addr);
+  void *old = pagedir_get_page (cur->pagedir, upage);
+  struct spt_entry *spte;
+  void *kpage;
+
+  if (!is_shared_frame_ft (old)) {
+    pagedir_set_cow (cur->pagedir, upage, false);
+    return true;
+  }
+
+  // Keep the old frame in place while we copy it; we still hold our
+  // share of it, so nobody else frees it either.
+  pin_frame_ft (old);
+  pagedir_clear_page (cur->pagedir, upage);
+  kpage = allocate_frame_ft (upage, true);
+  if (kpage != NULL) {
+    memcpy (kpage, old, PGSIZE);
+    unpin_frame_ft (kpage);
+  }
+  unpin_frame_ft (old);
+  unshare_frame_ft (old);
+  if (kpage == NULL) {
+    return false;
+  }
+
+  // The private copy may be evicted, so it needs an entry to come back
+  // from swap by, even if the page was originally loaded from the
+  // executable.
+  spte = get_entry_spt ((void *) pg_no (upage));
+  if (spte == NULL) {
+    spte = slab_alloc (&spt_cache);
+    if (spte == NULL) {
+      return false;
+    }
+    spte->page_num = (void *) pg_no (upage);
+    if (!insert_spt (cur, spte)) {
+      slab_free (&spt_cache, spte);
+      return false;
+    }
+  }
+  spte->frame_num = (void *) pg_no (kpage);
+  return true;
+}
+
+/* Adds a copy of SRC, an entry of another process's supplemental page
+   table, to the current process's.  Returns the copy, or a null
+   pointer if out of memory. */
+static struct spt_entry *
+copy_entry_spt (const struct spt_entry *src) {
+  struct spt_entry *spte = slab_alloc (&spt_cache);
+
+  if (spte != NULL) {
+    *spte = *src;
+    if (!insert_spt (thread_current (), spte)) {
+      slab_free (&spt_cache, spte);
+      spte = NULL;
+    }
+  }
+  return spte;
 }
 
 /* Create a new entry and add it to the supplemental page table.
    Returns TRUE if operation succeeds, FALSE otherwise. */
 bool 
 create_entry_spt(void *vaddr) {
-  struct spt_entry *spte = malloc(sizeof(struct spt_entry));
-  uint32_t *kpage = allocate_frame_ft(vaddr);                                               
+  struct spt_entry *spte = slab_alloc(&spt_cache);
+  uint32_t *kpage;
 
+  if (spte == NULL) {
+    return false;
+  }
+  kpage = allocate_frame_ft(vaddr, false);
   if (kpage != NULL) {
     // (1) Create the Supplemental Page Table entry
     spte->page_num = pg_no (vaddr);
     spte->frame_num = pg_no (kpage);
-    spte->in_swap = false;
-    spte->mapid = -1;
 
-    // (2) Add the frame-to-page mapping to the Frame Table
-    add_entry_ft (spte->frame_num, spte->page_num);
-    // hash_insert returns a null pointer if no element equal to element previously existed in it
-    return (hash_insert (&thread_current()->sup_page_table, &spte->hash_elem) == NULL); 
+    // (2) allocate_frame_ft() has already added the frame-to-page
+    //     mapping to the Frame Table.
+    // insert_spt fails if the page already has an entry: then give
+    // back the frame, its mapping and the entry.
+    if (!insert_spt (thread_current (), spte)) {
+      pagedir_clear_page (thread_current ()->pagedir, pg_round_down (vaddr));
+      remove_entry_ft (kpage);
+      palloc_free_page (kpage);
+      slab_free (&spt_cache, spte);
+      return false;
+    }
+    return true;
   } else {
-    free(spte);
+    slab_free(&spt_cache, spte);
     return false;
   }
 }
@@ -142,32 +460,28 @@ create_entry_spt(void *vaddr) {
    PAGE NUM, or a null pointer if no such entry exists. */
 struct spt_entry *
 get_entry_spt(const void *page_num) { 	
-  struct spt_entry spte;
-  struct hash_elem *e;
+  return lookup_spt (thread_current (), page_num);
+}
 
-  spte.page_num = page_num;
-  e = hash_find (&thread_current()->sup_page_table, &spte.hash_elem);
-  return e != NULL ? hash_entry (e, struct spt_entry, hash_elem) : NULL;
+/* Returns the entry for PAGE_NUM in T's supplemental page table, or a
+   null pointer if no such entry exists. */
+static struct spt_entry *
+lookup_spt (struct thread *t, const void *page_num) {
+  struct spt_entry **slot = find_slot_spt (t, page_num, false);
+  return slot != NULL ? *slot : NULL;
 }
 
 /* Removes the entry from the supplemental page table with the given
    PAGE NUM. */
 void
 remove_entry_spt(const void *page_num) {
-  struct spt_entry spte;
-  struct spt_entry *spte_to_free = get_entry_spt (page_num);
-  struct hash_elem *e;
+  struct spt_entry **slot = find_slot_spt (thread_current (), page_num, false);
 
-  spte.page_num = page_num;
-  e = hash_delete (&thread_current()->sup_page_table, &spte.hash_elem);
-  if (e == NULL) {
+  if (slot == NULL || *slot == NULL) {
     PANIC("Couldn't find the supplemental page table entry for removal!");
   }
-  if (spte_to_free != NULL) {
-    free(spte_to_free);
-  } else {
-    PANIC("Couldn't find the supplemental page table entry to free!");
-  }
+  slab_free(&spt_cache, *slot);
+  *slot = NULL;
 }
 
 
@@ -175,13 +489,7 @@ remove_entry_spt(const void *page_num) {
    virtual address, or a null pointer if no such entry exists. */
 struct spt_entry *
 get_entry_from_vaddr_spt(const void *vaddr) {   
-  struct spt_entry spte;
-  struct hash_elem *e;
-  spte.page_num = pg_no (vaddr);
-  struct thread * t = thread_current();
-  struct hash * h = &t->sup_page_table;
-  e = hash_find (h, &spte.hash_elem);
-  return e != NULL ? hash_entry (e, struct spt_entry, hash_elem) : NULL;
+  return lookup_spt (thread_current (), (void *) pg_no (vaddr));
 }
 
 
@@ -193,19 +501,21 @@ page_is_in_swap_spt (const void *page_num) {
 }
 
 
-/* Notifies the supplemental page table that the page at page num PAGE NUM
-   is getting swapped out, that is, stored to the swap partition. The SECTOR_NUM
-   marks the beginning of the swap slot. Returns TRUE if the page lookup was successful
-  (if the page was in the supplemental page table) and FALSE otherwise. */
+/* Notifies T's supplemental page table that its page at page num PAGE NUM
+   is getting swapped out, that is, stored to the swap partition. T is the
+   page's owner, which is usually not the thread doing the eviction. The
+   SECTOR_NUM marks the beginning of the swap slot. Returns TRUE if the page
+   lookup was successful (if the page was in the supplemental page table)
+   and FALSE otherwise. */
 bool
-swap_page_out_spt (const void *page_num, int sector_num) {
-  struct spt_entry *spte = get_entry_spt (page_num);
+swap_page_out_spt (struct thread *t, const void *page_num, int sector_num) {
+  struct spt_entry *spte = lookup_spt (t, page_num);
   if (spte == NULL) {
     return false;
   } else {
     void * page = spte->page_num;             // This bitshifting to create a physical
     uint32_t vaddr = ((uint32_t) page) << 12; // address is a potential source of error
-    pagedir_clear_page (thread_current()->pagedir, vaddr); // Clear the frame associated with this page
+    pagedir_clear_page (t->pagedir, vaddr); // Clear the frame associated with this page
     spte->in_swap = true;
     spte->sector_num = sector_num;
     return true;
@@ -236,13 +546,12 @@ get_all_swapped_out_sector_nums_spt (void) {
   struct list *swapped_out_sectors;
   list_init (swapped_out_sectors);
 
-  struct hash_iterator i;
-
-  hash_first (&i, &thread_current()->sup_page_table);
+  struct thread *t = thread_current ();
+  struct spt_entry *spte;
 
-  while (hash_next (&i))
+  for (spte = next_entry_spt (t, 0); spte != NULL;
+       spte = next_entry_spt (t, (uint8_t *) spte->page_num + 1))
   {
-    struct spt_entry *spte = hash_entry (hash_cur (&i), struct spt_entry, hash_elem);
     if (spte->in_swap == true) {
       struct sector_item si;
       si.sector_num = spte->sector_num;
@@ -267,18 +576,21 @@ get_entry_from_swap_spt (const void *page_num) {
     if (allocate_new_frame(spte)) {
       void * frame = spte->frame_num;            // This bitshifting to create a physical
       uint32_t faddr = ((uint32_t) frame) << 12; // address is a potential source of error      
-      return swap_frame_in_st(spte->sector_num, faddr);                                          
+      bool success = swap_frame_in_st(spte->sector_num, faddr);
+      unpin_frame_ft ((void *) faddr);
+      return success;
     }
 }
 
 
 /* Allocates a new frame for the given supplemental page table entry by
-   calling into the frame table. Returns TRUE if successful, FALSE otherwise. */
+   calling into the frame table.  The frame is pinned for the caller to
+   fill and unpin. Returns TRUE if successful, FALSE otherwise. */
 static bool 
 allocate_new_frame(struct spt_entry *spte) {  
   void * page = spte->page_num;             // This bitshifting to create a virtual
   uint32_t vaddr = ((uint32_t) page) << 12; // address is a potential source of error
-  uint32_t *kpage = allocate_frame_ft(vaddr);                                               
+  uint32_t *kpage = allocate_frame_ft(vaddr, true);
 
   if (kpage != NULL) {
     spte->frame_num = pg_no (kpage);
@@ -20,18 +20,19 @@ init_st(void)
 }
 
 /* SUMMARY: Swaps a given frame in memory into swap disk
-   INPUT: Frame number to be swapped out and stored in swap disk.
+   INPUT: Frame number to be swapped out and stored in swap disk,
+   and the thread and page number it holds, from get_owner_ft().
 
    Checks if swap partition is not full, otherwise PANIC.
    Finds an empty swap slot and updates the bitmap to indicate
    it is now in use.
-   Finds the page associated with given frame and notifies
-   corresponding supplementary page table where the page is
-   being stored in swap disk.
+   Notifies the owner's supplementary page table where the page
+   is being stored in swap disk; if it has no entry for the page,
+   gives the swap slot back and returns false.
    Writes the frame to the swap disk.	
  */
 bool 
-swap_frame_out_st(void * frame_number)
+swap_frame_out_st(void * frame_number, struct thread * owner, void * page_number)
 {
 	lock_acquire(&st_lock);
 
@@ -45,8 +46,11 @@ swap_frame_out_st(void * frame_number)
 		PANIC("Error, swap partition is full");
 	}
 
-	void* page_number = get_entry_ft(frame_number);
-   	swap_page_out_spt(page_number, sector);
+	if(!swap_page_out_spt(owner, page_number, sector)) {
+		bitmap_set_multiple(st_bitmap, sector, SECTORS_PER_PAGE, SWAP_FREE);
+		lock_release(&st_lock);
+		return false;
+	}
 
    	int i;
    	for(i = 0; i < SECTORS_PER_PAGE; i++) {
@@ -95,6 +99,31 @@ swap_frame_in_st(block_sector_t sector, void * buffer)
 	return true;
 }
 
+/* SUMMARY: Copies a frame in swap disk into memory
+   INPUT: Initial sector where the frame is stored.
+
+   Like swap_frame_in_st() but leaves the swap slot in use, for when
+   the page is copied rather than moved, as by fork.
+ */
+void
+swap_read_st(block_sector_t sector, void * buffer)
+{
+	lock_acquire(&st_lock);
+
+	if(bitmap_test(st_bitmap, sector) == SWAP_FREE) {
+		PANIC("Error trying to read a free block");
+	}
+
+	int i;
+	for(i = 0; i < SECTORS_PER_PAGE; i++) {
+		block_read(swap_block, sector, buffer);
+		buffer += BLOCK_SECTOR_SIZE;
+		sector++;
+	}
+
+	lock_release(&st_lock);
+}
+
 /* SUMMARY: Frees all frames stored in swap disk for the current thread
    
    Fetches the start sectors for each page associated with the current